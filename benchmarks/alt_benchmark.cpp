@@ -0,0 +1,107 @@
+// ALT preprocessing time, memory per landmark and query speedup for several K.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+
+struct QueryRun {
+    double avg_settled;
+    double avg_query_us;
+    vector<double> total_times;
+};
+
+QueryRun RunQueries(const RouteManager& manager, const vector<string>& stop_names) {
+    const int query_count = 2000;
+    QueryRun run{0, 0, {}};
+    mt19937 rng(7);
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < query_count; ++i) {
+        const auto& from = stop_names[rng() % stop_names.size()];
+        const auto& to = stop_names[rng() % stop_names.size()];
+        const auto response = manager.ReadRouteSearch(from, to, i);
+        run.total_times.push_back(response.total_time);
+        run.avg_settled += Graph::PathSearch<RouteManager::GraphWeight>::LastStats().settled_vertices;
+    }
+    run.avg_query_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / query_count;
+    run.avg_settled /= query_count;
+    return run;
+}
+
+void Compare(const string& title, RouteManager& manager, size_t stop_count,
+        const vector<string>& stop_names, RoutingSettings settings) {
+    settings.router = RouterMode::DIJKSTRA;
+    manager.RunGraphBuilder(settings);
+    const QueryRun dijkstra = RunQueries(manager, stop_names);
+    cout << title << " dijkstra avg_settled: " << dijkstra.avg_settled
+         << " avg_query_us: " << dijkstra.avg_query_us << "\n";
+
+    settings.router = RouterMode::ALT;
+    for (size_t k : {1, 2, 4, 8, 16}) {
+        settings.landmark_count = k;
+        const size_t edge_count = manager.BuildGraph(settings);
+        const auto start = chrono::steady_clock::now();
+        manager.PrecomputeRouter();
+        const double preprocess_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        const QueryRun alt = RunQueries(manager, stop_names);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < alt.total_times.size(); ++i) {
+            mismatches += abs(alt.total_times[i] - dijkstra.total_times[i]) > 1e-6;
+        }
+        cout << title << " alt k: " << k
+             << " edges: " << edge_count
+             << " preprocess_ms: " << preprocess_ms
+             << " bytes_per_landmark: " << 2 * sizeof(float) * 2 * stop_count
+             << " avg_settled: " << alt.avg_settled
+             << " avg_query_us: " << alt.avg_query_us
+             << " speedup: " << dijkstra.avg_query_us / alt.avg_query_us
+             << " mismatches: " << mismatches << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RoutingSettings settings = ReadSettings(document.GetRoot());
+        settings.layout = GraphLayout::SPATIAL;
+
+        RouteManager manager;
+        vector<string> stop_names;
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        ProcessRequests(requests, manager);
+        Compare("input4", manager, stop_names.size(), stop_names, settings);
+    }
+    {
+        NetworkConfig config;
+        config.stop_count = 20000;
+        config.route_count = 2500;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        // query only stops that some route serves
+        set<string> served;
+        for (const auto& route : network.routes) {
+            served.insert(route.stops.begin(), route.stops.end());
+        }
+        const vector<string> stop_names(served.begin(), served.end());
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_20000", manager, network.stops.size(), stop_names, settings);
+    }
+}
@@ -0,0 +1,95 @@
+// Latency of Route queries asking for k itineraries as k grows.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+
+void Compare(const string& title, RouteManager& manager, const vector<string>& stop_names, RoutingSettings settings) {
+    const int query_count = 500;
+    settings.router = RouterMode::DIJKSTRA;
+    manager.RunGraphBuilder(settings);
+
+    vector<pair<string, string>> queries;
+    mt19937 rng(7);
+    for (int i = 0; i < query_count; ++i) {
+        queries.emplace_back(stop_names[rng() % stop_names.size()], stop_names[rng() % stop_names.size()]);
+    }
+    vector<double> best_times;
+    for (const auto& [from, to] : queries) {
+        best_times.push_back(manager.ReadRouteSearch(from, to, 0).total_time);
+    }
+
+    for (size_t k : {1, 2, 4, 8, 16}) {
+        size_t settled = 0, relaxed = 0, itineraries = 0, mismatches = 0;
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto response = manager.ReadRouteSearch(queries[i].first, queries[i].second, i, k - 1);
+            settled += Graph::PathSearch<RouteManager::GraphWeight>::LastStats().settled_vertices;
+            relaxed += Graph::PathSearch<RouteManager::GraphWeight>::LastStats().relaxed_edges;
+            if (!response.stats) {
+                continue;
+            }
+            itineraries += 1 + response.alternatives.size();
+            // the fastest comes first and the rest never get faster
+            double previous = response.total_time;
+            mismatches += abs(previous - best_times[i]) > 1e-6;
+            for (const auto& alternative : response.alternatives) {
+                mismatches += alternative.total_time < previous - 1e-6;
+                previous = alternative.total_time;
+            }
+        }
+        const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << title << " k: " << k
+             << " avg_itineraries: " << static_cast<double>(itineraries) / query_count
+             << " avg_settled: " << settled / query_count
+             << " avg_relaxed: " << relaxed / query_count
+             << " avg_query_us: " << ms * 1000 / query_count
+             << " mismatches: " << mismatches << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RoutingSettings settings = ReadSettings(document.GetRoot());
+        settings.layout = GraphLayout::SPATIAL;
+
+        RouteManager manager;
+        vector<string> stop_names;
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        ProcessRequests(requests, manager);
+        Compare("input4", manager, stop_names, settings);
+    }
+    {
+        NetworkConfig config;
+        config.stop_count = 2000;
+        config.route_count = 250;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        set<string> served;
+        for (const auto& route : network.routes) {
+            served.insert(route.stops.begin(), route.stops.end());
+        }
+        const vector<string> stop_names(served.begin(), served.end());
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_2000", manager, stop_names, settings);
+    }
+}
@@ -0,0 +1,79 @@
+// Settled vertices and latency of A* against plain Dijkstra for Route queries.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+void Compare(const string& title, RouteManager& manager, const vector<string>& stop_names, RoutingSettings settings) {
+    const int query_count = 2000;
+    vector<double> times[2];
+    for (RouterMode mode : {RouterMode::DIJKSTRA, RouterMode::A_STAR}) {
+        settings.router = mode;
+        manager.RunGraphBuilder(settings);
+
+        mt19937 rng(7);
+        size_t settled = 0;
+        auto& mode_times = times[mode == RouterMode::A_STAR];
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto& from = stop_names[rng() % stop_names.size()];
+            const auto& to = stop_names[rng() % stop_names.size()];
+            const auto response = manager.ReadRouteSearch(from, to, i);
+            mode_times.push_back(response.total_time);
+            settled += Graph::PathSearch<RouteManager::GraphWeight>::LastStats().settled_vertices;
+        }
+        const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << title << (mode == RouterMode::A_STAR ? " astar" : " dijkstra")
+             << " avg_settled: " << settled / query_count
+             << " avg_query_us: " << ms * 1000 / query_count << "\n";
+    }
+    size_t mismatches = 0;
+    for (int i = 0; i < query_count; ++i) {
+        mismatches += abs(times[0][i] - times[1][i]) > 1e-6;
+    }
+    cout << title << " mismatches: " << mismatches << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RoutingSettings settings = ReadSettings(document.GetRoot());
+        settings.layout = GraphLayout::SPATIAL;
+
+        RouteManager manager;
+        vector<string> stop_names;
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        ProcessRequests(requests, manager);
+        Compare("input4", manager, stop_names, settings);
+    }
+    for (size_t stop_count : {2000, 20000}) {
+        NetworkConfig config;
+        config.stop_count = stop_count;
+        config.route_count = stop_count / 8;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        vector<string> stop_names;
+        for (const auto& stop : network.stops) {
+            stop_names.push_back(stop.name);
+        }
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_" + to_string(stop_count), manager, stop_names, settings);
+    }
+}
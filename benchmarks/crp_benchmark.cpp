@@ -0,0 +1,111 @@
+// Customizable route planning: the time to switch to new routing settings
+// by building the graph and the CRP overlay from scratch against
+// reweighting the waits and customizing the overlay of the partition
+// already built, then the Route latency of CRP against Dijkstra and
+// whether the totals agree.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static vector<double> RouteTimes(const RouteManager& manager, const vector<pair<string, string>>& queries,
+        double& avg_query_us) {
+    vector<double> times;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto response = manager.ReadRouteSearch(queries[i].first, queries[i].second, static_cast<int>(i));
+        times.push_back(response.stats ? response.total_time : -1);
+    }
+    avg_query_us = MillisecondsSince(start) * 1000 / queries.size();
+    return times;
+}
+
+void Compare(const string& title, RouteManager& manager, const vector<string>& stop_names,
+        RoutingSettings settings) {
+    mt19937 rng(7);
+    vector<pair<string, string>> queries(1000);
+    for (auto& query : queries) {
+        query = {stop_names[rng() % stop_names.size()], stop_names[rng() % stop_names.size()]};
+    }
+    // wait in minutes and velocity in km/h
+    const vector<pair<int, double>> variants = {{6, 40}, {2, 30}, {10, 60}, {4, 25}};
+    settings.router = RouterMode::CRP;
+    manager.RunGraphBuilder(settings);
+    for (const auto& [wait, velocity] : variants) {
+        settings.bus_wait_time = wait;
+        settings.bus_velocity = velocity * 1000 / 60;
+
+        auto start = Clock::now();
+        manager.RunGraphBuilder(settings);
+        const double rebuild_ms = MillisecondsSince(start);
+        start = Clock::now();
+        manager.UpdateRoutingSettings(settings);
+        const double customize_ms = MillisecondsSince(start);
+        double crp_us = 0, dijkstra_us = 0;
+        const vector<double> times = RouteTimes(manager, queries, crp_us);
+
+        settings.router = RouterMode::DIJKSTRA;
+        manager.RunGraphBuilder(settings);
+        const vector<double> expected = RouteTimes(manager, queries, dijkstra_us);
+        settings.router = RouterMode::CRP;
+        manager.RunGraphBuilder(settings);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            mismatches += abs(times[i] - expected[i]) > 1e-9 * max(1.0, expected[i]);
+        }
+        cout << title << " wait: " << wait << " velocity: " << velocity
+             << " rebuild_ms: " << rebuild_ms
+             << " customize_ms: " << customize_ms
+             << " crp_query_us: " << crp_us
+             << " dijkstra_query_us: " << dijkstra_us
+             << " mismatches: " << mismatches << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RouteManager manager;
+        vector<string> stop_names;
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        ProcessRequests(requests, manager);
+        Compare("input4", manager, stop_names, ReadSettings(document.GetRoot()));
+    }
+    {
+        NetworkConfig config;
+        config.stop_count = 20000;
+        config.route_count = 2500;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        set<string> served;
+        for (const auto& route : network.routes) {
+            served.insert(route.stops.begin(), route.stops.end());
+        }
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_20000", manager, {served.begin(), served.end()}, settings);
+    }
+}
@@ -0,0 +1,100 @@
+// Graph compaction: edge counts, router precompute time and Dijkstra Route
+// latency with all edges, with parallel edges merged, and with rides a
+// loop of their own route beats pruned as well.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// precompute runs the given router, queries run Dijkstra
+void Compare(const string& title, RouteManager& manager, const vector<string>& stop_names,
+        RoutingSettings settings, RouterMode precompute) {
+    const int query_count = 2000;
+    vector<double> expected;
+    for (const int level : {0, 1, 2}) {
+        settings.merge_parallel_edges = level >= 1;
+        settings.prune_dominated_edges = level >= 2;
+        settings.router = precompute;
+        auto start = Clock::now();
+        const size_t edge_count = manager.BuildGraph(settings);
+        const double build_ms = MillisecondsSince(start);
+        start = Clock::now();
+        manager.PrecomputeRouter();
+        const double precompute_ms = MillisecondsSince(start);
+
+        settings.router = RouterMode::DIJKSTRA;
+        manager.RunGraphBuilder(settings);
+        mt19937 rng(7);
+        vector<double> times;
+        start = Clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto& from = stop_names[rng() % stop_names.size()];
+            const auto& to = stop_names[rng() % stop_names.size()];
+            const auto response = manager.ReadRouteSearch(from, to, i);
+            times.push_back(response.stats ? response.total_time : -1);
+        }
+        const double query_us = MillisecondsSince(start) * 1000 / query_count;
+        if (expected.empty()) {
+            expected = times;
+        }
+        size_t mismatches = 0;
+        for (int i = 0; i < query_count; ++i) {
+            mismatches += abs(times[i] - expected[i]) > 1e-9 * max(1.0, expected[i]);
+        }
+        cout << title << (level == 0 ? " all_edges" : level == 1 ? " merged" : " merged_pruned")
+             << " edges: " << edge_count
+             << " build_ms: " << build_ms
+             << " precompute_ms: " << precompute_ms
+             << " avg_query_us: " << query_us
+             << " mismatches: " << mismatches << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RoutingSettings settings = ReadSettings(document.GetRoot());
+        settings.layout = GraphLayout::SPATIAL;
+
+        RouteManager manager;
+        vector<string> stop_names;
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        ProcessRequests(requests, manager);
+        Compare("input4", manager, stop_names, settings, RouterMode::ALL_PAIRS);
+    }
+    {
+        NetworkConfig config;
+        config.stop_count = 20000;
+        config.route_count = 2500;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        vector<string> stop_names;
+        for (const auto& route : network.routes) {
+            stop_names.insert(stop_names.end(), route.stops.begin(), route.stops.end());
+        }
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_20000", manager, stop_names, settings, RouterMode::HUB_LABELS);
+    }
+}
@@ -0,0 +1,31 @@
+// Graph build time for a synthetic 5k-route network at several thread counts.
+#include "network_generator.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 20000;
+    config.route_count = 5000;
+    config.route_length = 20;
+    const SyntheticNetwork network = GenerateNetwork(config);
+
+    RouteManager manager;
+    network.LoadInto(manager);
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << "\n";
+    for (size_t threads : {1, 2, 4, 8}) {
+        RoutingSettings settings{6, 40 * 1000.0 / 60, threads};
+        const auto start = chrono::steady_clock::now();
+        const size_t edge_count = manager.BuildGraph(settings);
+        const auto finish = chrono::steady_clock::now();
+        cout << "threads: " << threads
+             << " edges: " << edge_count
+             << " build_ms: " << chrono::duration<double, milli>(finish - start).count() << "\n";
+    }
+}
@@ -0,0 +1,46 @@
+// Router precompute and query time for the hash-order and spatial graph layouts.
+#include "network_generator.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 500;
+    config.route_count = 150;
+    config.route_length = 12;
+    const SyntheticNetwork network = GenerateNetwork(config);
+
+    RouteManager manager;
+    network.LoadInto(manager);
+
+    for (GraphLayout layout : {GraphLayout::HASH, GraphLayout::SPATIAL}) {
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = layout;
+        manager.BuildGraph(settings);
+
+        auto start = chrono::steady_clock::now();
+        manager.PrecomputeRouter();
+        const double precompute_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        mt19937 rng(7);
+        double total_time = 0;
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < 100000; ++i) {
+            const auto& from = network.stops[rng() % network.stops.size()].name;
+            const auto& to = network.stops[rng() % network.stops.size()].name;
+            const auto response = manager.ReadRouteSearch(from, to, i);
+            total_time += response.total_time;
+        }
+        const double query_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        cout << (layout == GraphLayout::HASH ? "hash" : "spatial")
+             << " precompute_ms: " << precompute_ms
+             << " queries_ms: " << query_ms
+             << " checksum: " << total_time << "\n";
+    }
+}
@@ -0,0 +1,111 @@
+// Hub labels over the transit graph of a synthetic network: build time,
+// label size and memory, and the latency of distance and path queries
+// against a Dijkstra search per query.
+#include "network_generator.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// keeps the distance queries from being optimized away
+static volatile int64_t checksum_sink;
+
+int main() {
+    const size_t query_count = 100000;
+    for (const size_t stop_count : {5000, 20000}) {
+        NetworkConfig config;
+        config.stop_count = stop_count;
+        config.route_count = stop_count / 8;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        settings.router = RouterMode::DIJKSTRA;
+        manager.BuildGraph(settings);
+        const auto& graph = manager.GetGraph();
+
+        auto start = Clock::now();
+        const Graph::HubLabels<RouteManager::GraphWeight> labels(graph);
+        const double build_ms = MillisecondsSince(start);
+        // stops no route serves have no edges and only themselves as hub
+        size_t linked = 0;
+        for (Graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+            linked += graph.GetIncidentEdges(vertex).begin() != graph.GetIncidentEdges(vertex).end()
+                || graph.GetIncomingEdges(vertex).begin() != graph.GetIncomingEdges(vertex).end();
+        }
+        const size_t linked_entries = labels.GetEntryCount() - 2 * (graph.GetVertexCount() - linked);
+        cout << "stops: " << stop_count << " vertices: " << graph.GetVertexCount()
+             << " linked: " << linked << " edges: " << graph.GetEdgeCount()
+             << " build_ms: " << build_ms
+             << " avg_linked_label: " << static_cast<double>(linked_entries) / (2 * linked)
+             << " memory_mb: " << labels.GetMemoryUsage() / 1048576.0 << "\n";
+
+        vector<Graph::VertexId> vertices;
+        for (Graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); vertex += 2) {
+            if (graph.GetIncidentEdges(vertex).begin() != graph.GetIncidentEdges(vertex).end()) {
+                vertices.push_back(vertex);
+            }
+        }
+        mt19937 rng(7);
+        vector<pair<Graph::VertexId, Graph::VertexId>> queries(query_count);
+        for (auto& query : queries) {
+            query = {vertices[rng() % vertices.size()], vertices[rng() % vertices.size()]};
+        }
+
+        start = Clock::now();
+        int64_t checksum = 0;
+        for (const auto& [from, to] : queries) {
+            checksum += labels.FindDistance(from, to).value_or(-1);
+        }
+        const double distance_us = MillisecondsSince(start) * 1000 / query_count;
+        checksum_sink = checksum;
+
+        start = Clock::now();
+        size_t path_edges = 0;
+        for (const auto& [from, to] : queries) {
+            const auto path = labels.FindPath(from, to);
+            path_edges += path ? path->edges.size() : 0;
+        }
+        const double path_us = MillisecondsSince(start) * 1000 / query_count;
+
+        // Dijkstra on a sample, checking the distances and the unpacked paths
+        const Graph::PathSearch<RouteManager::GraphWeight> search(graph);
+        const size_t checked = 1000;
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < checked; ++i) {
+            const auto [from, to] = queries[i];
+            const auto expected = search.FindPath(from, to);
+            const auto path = labels.FindPath(from, to);
+            if (!expected || !path) {
+                mismatches += expected.has_value() != path.has_value();
+                continue;
+            }
+            RouteManager::GraphWeight weight = 0;
+            Graph::VertexId vertex = from;
+            for (const Graph::EdgeId edge_id : path->edges) {
+                const auto& edge = graph.GetEdge(edge_id);
+                mismatches += edge.from != vertex;
+                weight += edge.weight;
+                vertex = edge.to;
+            }
+            mismatches += vertex != to || weight != expected->weight || path->weight != expected->weight;
+        }
+        const double dijkstra_us = MillisecondsSince(start) * 1000 / checked;
+        cout << "distance_query_us: " << distance_us
+             << " path_query_us: " << path_us
+             << " avg_path_edges: " << static_cast<double>(path_edges) / query_count
+             << " dijkstra_query_us: " << dijkstra_us
+             << " mismatches: " << mismatches << "\n";
+    }
+}
@@ -0,0 +1,122 @@
+// Input loading: reading a document through an istream, with read() and
+// through mmap, then parsing it from memory and destroying the tree.
+//
+// usage: json_load_benchmark FILE [parse=0]
+//        json_load_benchmark --generate FILE MEGABYTES
+// --generate writes a synthetic feed of Stop requests of about the given size.
+#include "input_buffer.h"
+#include "json.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+#ifndef TRANSPORT_METRICS
+// the metrics build replaces operator new itself
+static size_t allocation_count = 0;
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* result = malloc(size ? size : 1)) {
+        return result;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+#endif
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+void Generate(const string& path, size_t megabytes) {
+    ofstream output(path);
+    output << "{\"routing_settings\": {\"bus_wait_time\": 6, \"bus_velocity\": 40},\n\"base_requests\": [";
+    for (size_t i = 0; static_cast<size_t>(output.tellp()) < (megabytes << 20); ++i) {
+        output << (i ? ",\n" : "\n") << "{\"type\": \"Stop\", \"name\": \"Stop " << i
+               << "\", \"latitude\": " << 55.5 + (i % 1000) * 0.000371
+               << ", \"longitude\": " << 37.3 + (i / 1000 % 1000) * 0.000613
+               << ", \"road_distances\": {\"Stop " << i + 1 << "\": " << 400 + i % 900
+               << ", \"Stop " << i + 1000 << "\": " << 350 + i % 700 << "}}";
+    }
+    output << "],\n\"stat_requests\": []}\n";
+}
+
+// sums the bytes so that every page is actually brought in
+size_t Touch(string_view text) {
+    size_t sum = 0;
+    for (const char c : text) {
+        sum += c;
+    }
+    return sum;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && string(argv[1]) == "--generate") {
+        Generate(argv[2], stoul(argv[3]));
+        return 0;
+    }
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " FILE [parse=0]\n";
+        return 1;
+    }
+    const string path = argv[1];
+    const bool parse = argc < 3 || string(argv[2]) != "parse=0";
+
+    size_t checksum = 0;
+    {
+        const auto start = Clock::now();
+        ifstream input(path);
+        const string text(istreambuf_iterator<char>(input), {});
+        checksum += Touch(text);
+        cout << "istream bytes: " << text.size() << " read_ms: " << MillisecondsSince(start) << "\n";
+    }
+    {
+        const auto start = Clock::now();
+        const int fd = open(path.c_str(), O_RDONLY);
+        const InputBuffer input = InputBuffer::FromDescriptor(fd);
+        close(fd);
+        checksum += Touch(input.View());
+        cout << "read    bytes: " << input.View().size() << " read_ms: " << MillisecondsSince(start) << "\n";
+    }
+    {
+        const auto start = Clock::now();
+        const InputBuffer input = InputBuffer::FromFile(path);
+        checksum += Touch(input.View());
+        cout << "mmap    bytes: " << input.View().size() << " read_ms: " << MillisecondsSince(start) << "\n";
+        if (parse) {
+#ifndef TRANSPORT_METRICS
+            const size_t allocations_before = allocation_count;
+#endif
+            auto parse_start = Clock::now();
+            auto document = make_unique<Json::Document>(Json::Load(input.View()));
+            cout << "parse_ms: " << MillisecondsSince(parse_start)
+                 << " base_requests: " << document->GetRoot().AsMap().at("base_requests").AsArray().size();
+#ifndef TRANSPORT_METRICS
+            cout << " allocations: " << allocation_count - allocations_before;
+#endif
+            parse_start = Clock::now();
+            document.reset();
+            cout << " destroy_ms: " << MillisecondsSince(parse_start) << "\n";
+        }
+    }
+    cerr << "checksum " << checksum << "\n";
+}
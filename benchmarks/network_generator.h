@@ -0,0 +1,227 @@
+#pragma once
+#include "route_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Seeded generator of synthetic transit networks. Stops sit on a jittered
+// grid and every route is a random walk over neighbouring grid cells that
+// starts on a stop served before, so routes are geographically coherent,
+// share stops the way real lines do and form one connected network.
+struct NetworkConfig {
+    size_t stop_count = 1000;
+    size_t route_count = 100;
+    size_t route_length = 10;
+    double roundtrip_ratio = 0.5;
+    // share of linked stop pairs that carry a road distance in both
+    // directions; the others give it one way and rely on the reverse fallback
+    double distance_density = 0;
+    // minutes between the departures of every route from first_departure
+    // to last_departure (minutes since midnight); 0 leaves out timetables
+    double headway = 0;
+    double first_departure = 5 * 60;
+    double last_departure = 24 * 60;
+    uint32_t seed = 42;
+};
+
+// number of stat requests of each type; Route queries pick stops on routes
+struct QueryMix {
+    size_t bus_count = 1000;
+    size_t stop_count = 1000;
+    size_t route_count = 1000;
+    uint32_t seed = 7;
+};
+
+struct SyntheticStop {
+    std::string name;
+    double lat, lon;
+    RouteManager::DistInfo road_distances;
+};
+
+struct SyntheticRoute {
+    std::string name;
+    std::vector<std::string> stops;
+    bool is_roundtrip;
+    std::vector<double> departures;
+};
+
+struct SyntheticQuery {
+    std::string type;
+    // route or stop name; from and to of a Route query
+    std::string name, to;
+};
+
+struct SyntheticNetwork {
+    std::vector<SyntheticStop> stops;
+    std::vector<SyntheticRoute> routes;
+    std::vector<SyntheticQuery> queries;
+
+    void LoadInto(RouteManager& manager) const {
+        for (const auto& stop : stops) {
+            manager.AddStop(stop.name, stop.lat, stop.lon, stop.road_distances);
+        }
+        for (const auto& route : routes) {
+            manager.AddRoute(route.name, route.stops, route.is_roundtrip, route.departures);
+        }
+    }
+
+    // the whole network and its queries as an input document of the program
+    void WriteJson(std::ostream& output,
+            const std::string& routing_settings = "\"bus_wait_time\": 6, \"bus_velocity\": 40") const {
+        output << std::setprecision(10) << "{\"routing_settings\": {" << routing_settings
+               << "},\n\"base_requests\": [";
+        const char* separator = "\n";
+        for (const auto& stop : stops) {
+            output << separator << "{\"type\": \"Stop\", \"name\": \"" << stop.name
+                   << "\", \"latitude\": " << stop.lat << ", \"longitude\": " << stop.lon
+                   << ", \"road_distances\": {";
+            for (size_t i = 0; i < stop.road_distances.size(); ++i) {
+                output << (i ? ", " : "") << "\"" << stop.road_distances[i].second << "\": "
+                       << stop.road_distances[i].first;
+            }
+            output << "}}";
+            separator = ",\n";
+        }
+        for (const auto& route : routes) {
+            output << separator << "{\"type\": \"Bus\", \"name\": \"" << route.name << "\", \"stops\": [";
+            for (size_t i = 0; i < route.stops.size(); ++i) {
+                output << (i ? ", " : "") << "\"" << route.stops[i] << "\"";
+            }
+            output << "], \"is_roundtrip\": " << (route.is_roundtrip ? "true" : "false");
+            if (!route.departures.empty()) {
+                output << ", \"departures\": [";
+                for (size_t i = 0; i < route.departures.size(); ++i) {
+                    output << (i ? ", " : "") << route.departures[i];
+                }
+                output << "]";
+            }
+            output << "}";
+        }
+        output << "],\n\"stat_requests\": [";
+        separator = "\n";
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto& query = queries[i];
+            output << separator << "{\"type\": \"" << query.type << "\", ";
+            if (query.type == "Route") {
+                output << "\"from\": \"" << query.name << "\", \"to\": \"" << query.to << "\", ";
+            } else {
+                output << "\"name\": \"" << query.name << "\", ";
+            }
+            output << "\"id\": " << i << "}";
+            separator = ",\n";
+        }
+        output << "]}\n";
+    }
+};
+
+inline SyntheticNetwork GenerateNetwork(const NetworkConfig& config) {
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<double> jitter(-0.3, 0.3);
+    std::uniform_real_distribution<double> detour(1.05, 1.6);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    SyntheticNetwork network;
+    const size_t side = std::max<size_t>(2, std::ceil(std::sqrt(config.stop_count)));
+    // roughly 400 m between neighbouring grid cells
+    const double step = 0.0036;
+    for (size_t i = 0; i < config.stop_count; ++i) {
+        const double row = i / side + jitter(rng);
+        const double col = i % side + jitter(rng);
+        network.stops.push_back({"S" + std::to_string(i), 55.5 + row * step, 37.3 + col * step * 1.7, {}});
+    }
+
+    auto neighbour = [&](size_t stop) {
+        const size_t row = stop / side, col = stop % side;
+        for (;;) {
+            const int dir = rng() % 4;
+            const long r = row + (dir == 0) - (dir == 1);
+            const long c = col + (dir == 2) - (dir == 3);
+            if (r >= 0 && c >= 0 && c < static_cast<long>(side)
+                    && static_cast<size_t>(r * side + c) < config.stop_count) {
+                return static_cast<size_t>(r * side + c);
+            }
+        }
+    };
+
+    std::vector<std::vector<size_t>> linked(config.stop_count);
+    std::vector<size_t> served;
+    auto link = [&](size_t a, size_t b) {
+        if (a == b || std::count(linked[a].begin(), linked[a].end(), b)) {
+            return;
+        }
+        const Coordinate from{network.stops[a].lat, network.stops[a].lon};
+        const Coordinate to{network.stops[b].lat, network.stops[b].lon};
+        const int road = static_cast<int>(DistanceBetweenCoordinates(from, to) * detour(rng)) + 1;
+        linked[a].push_back(b);
+        linked[b].push_back(a);
+        network.stops[a].road_distances.emplace_back(road, network.stops[b].name);
+        if (config.distance_density > 0 && unit(rng) < config.distance_density) {
+            const int back = static_cast<int>(DistanceBetweenCoordinates(to, from) * detour(rng)) + 1;
+            network.stops[b].road_distances.emplace_back(back, network.stops[a].name);
+        }
+    };
+
+    for (size_t i = 0; i < config.route_count; ++i) {
+        SyntheticRoute route{"R" + std::to_string(i), {}, unit(rng) < config.roundtrip_ratio, {}};
+        // new routes start on an already served stop, so the network stays connected
+        size_t stop = network.routes.empty()
+            ? rng() % config.stop_count
+            : served[rng() % served.size()];
+        std::vector<size_t> path{stop};
+        while (path.size() + (route.is_roundtrip ? 1 : 0) < config.route_length) {
+            size_t next = neighbour(stop);
+            if (path.size() > 1 && next == path[path.size() - 2]) {
+                next = neighbour(stop);
+            }
+            link(stop, next);
+            path.push_back(stop = next);
+        }
+        if (route.is_roundtrip && stop != path.front()) {
+            link(stop, path.front());
+            path.push_back(path.front());
+        }
+        for (size_t id : path) {
+            route.stops.push_back(network.stops[id].name);
+        }
+        served.insert(served.end(), path.begin(), path.end());
+        network.routes.push_back(std::move(route));
+    }
+    if (config.headway > 0) {
+        // each route starts its day at its own offset within the headway
+        for (auto& route : network.routes) {
+            for (double departure = config.first_departure + unit(rng) * config.headway;
+                    departure < config.last_departure; departure += config.headway) {
+                route.departures.push_back(std::round(departure));
+            }
+        }
+    }
+    return network;
+}
+
+inline SyntheticNetwork GenerateNetwork(const NetworkConfig& config, const QueryMix& mix) {
+    SyntheticNetwork network = GenerateNetwork(config);
+    std::mt19937 rng(mix.seed);
+    std::vector<const std::string*> served;
+    for (const auto& route : network.routes) {
+        for (const auto& stop : route.stops) {
+            served.push_back(&stop);
+        }
+    }
+    for (size_t i = 0; i < mix.bus_count; ++i) {
+        network.queries.push_back({"Bus", network.routes[rng() % network.routes.size()].name, {}});
+    }
+    for (size_t i = 0; i < mix.stop_count; ++i) {
+        network.queries.push_back({"Stop", network.stops[rng() % network.stops.size()].name, {}});
+    }
+    for (size_t i = 0; i < mix.route_count && !served.empty(); ++i) {
+        network.queries.push_back({"Route", *served[rng() % served.size()], *served[rng() % served.size()]});
+    }
+    std::shuffle(network.queries.begin(), network.queries.end(), rng);
+    return network;
+}
@@ -0,0 +1,143 @@
+// End-to-end benchmark over a generated network: times every pipeline phase
+// and every stat request type, and prints one JSON object per run so that
+// results can be collected and compared across changes.
+//
+// usage: pipeline_benchmark [key=value...]
+//   stops routes length roundtrip density seed    network shape
+//   bus stop route                                  stat requests of each type
+//   router=all_pairs|dijkstra|astar|alt|bidirectional
+//   repeat=N    run the pipeline N times, phases report the fastest run
+//   emit=PATH   also write the generated input document there
+#include "json.h"
+#include "metrics.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    map<string, string> args = {
+        {"stops", "2000"}, {"routes", "200"}, {"length", "15"}, {"roundtrip", "0.5"},
+        {"density", "0.5"}, {"seed", "42"}, {"bus", "2000"}, {"stop", "2000"},
+        {"route", "2000"}, {"router", "dijkstra"}, {"repeat", "1"}, {"emit", ""}
+    };
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const size_t pos = arg.find('=');
+        if (pos == string::npos || !args.count(arg.substr(0, pos))) {
+            cerr << "unknown argument " << arg << "\n";
+            return 1;
+        }
+        args[arg.substr(0, pos)] = arg.substr(pos + 1);
+    }
+
+    NetworkConfig config;
+    config.stop_count = stoul(args["stops"]);
+    config.route_count = stoul(args["routes"]);
+    config.route_length = stoul(args["length"]);
+    config.roundtrip_ratio = stod(args["roundtrip"]);
+    config.distance_density = stod(args["density"]);
+    config.seed = stoul(args["seed"]);
+    QueryMix mix;
+    mix.bus_count = stoul(args["bus"]);
+    mix.stop_count = stoul(args["stop"]);
+    mix.route_count = stoul(args["route"]);
+
+    ostringstream document_text;
+    GenerateNetwork(config, mix).WriteJson(document_text,
+        "\"bus_wait_time\": 6, \"bus_velocity\": 40, \"router\": \"" + args["router"] + "\"");
+    const string input = document_text.str();
+    if (!args["emit"].empty()) {
+        ofstream(args["emit"]) << input;
+    }
+
+    map<string, double> phases;
+    auto record = [&phases](const string& phase, double ms) {
+        const auto it = phases.find(phase);
+        phases[phase] = it == phases.end() ? ms : min(it->second, ms);
+    };
+    map<string, Metrics::Histogram> latencies;
+    size_t edge_count = 0, output_size = 0;
+
+    for (int run = 0; run < stoi(args["repeat"]); ++run) {
+        auto start = Clock::now();
+        istringstream stream(input);
+        const Json::Document document = Json::Load(stream);
+        record("json_load", MillisecondsSince(start));
+
+        start = Clock::now();
+        RouteManager manager;
+        ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+        record("ingest", MillisecondsSince(start));
+
+        const RoutingSettings settings = ReadSettings(document.GetRoot());
+        start = Clock::now();
+        edge_count = manager.BuildGraph(settings);
+        record("graph_build", MillisecondsSince(start));
+
+        start = Clock::now();
+        manager.PrecomputeRouter();
+        record("router_precompute", MillisecondsSince(start));
+
+        start = Clock::now();
+        const auto requests = ReadRequests<StatRequests>(document.GetRoot());
+        record("stat_parse", MillisecondsSince(start));
+
+        // every request on its own, to get per-type latency distributions
+        vector<Response> responses;
+        responses.reserve(requests.size());
+        const auto queries_start = Clock::now();
+        for (const auto& request : requests) {
+            start = Clock::now();
+            responses.push_back(ProcessRequest(request, manager));
+            const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+            latencies[visit([](const auto& alternative) { return string(alternative.NAME); }, request)].Record(elapsed);
+        }
+        record("stat_process", MillisecondsSince(queries_start));
+
+        start = Clock::now();
+        ostringstream output;
+        PrintResponses(responses, output);
+        output_size = output.str().size();
+        record("output", MillisecondsSince(start));
+    }
+
+    cout << "{\"benchmark\": \"pipeline\", \"config\": {";
+    bool first = true;
+    for (const auto& [key, value] : args) {
+        if (key != "emit") {
+            cout << (first ? "" : ", ") << "\"" << key << "\": \"" << value << "\"";
+            first = false;
+        }
+    }
+    cout << "}, \"input_bytes\": " << input.size() << ", \"output_bytes\": " << output_size
+         << ", \"edges\": " << edge_count << ", \"phases_ms\": {";
+    first = true;
+    for (const auto& [phase, ms] : phases) {
+        cout << (first ? "" : ", ") << "\"" << phase << "\": " << ms;
+        first = false;
+    }
+    cout << "}, \"queries\": {";
+    first = true;
+    for (const auto& [type, histogram] : latencies) {
+        cout << (first ? "" : ", ") << "\"" << type << "\": {\"count\": " << histogram.Count()
+             << ", \"mean_us\": " << histogram.Total() / 1e3 / max<uint64_t>(1, histogram.Count())
+             << ", \"p50_us\": " << histogram.Percentile(0.5) / 1e3
+             << ", \"p99_us\": " << histogram.Percentile(0.99) / 1e3 << "}";
+        first = false;
+    }
+    cout << "}}\n";
+}
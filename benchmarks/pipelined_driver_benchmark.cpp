@@ -0,0 +1,88 @@
+// Wall time from a loaded document to printed output: the phases one after
+// another (RunGraphBuilder, parse the stat requests, answer, print) against
+// BuildAndAnswer, which parses the stat requests and answers the Bus and
+// Stop ones while the graph and router build. Fastest of several runs, on
+// input4 and on a generated network heavy on Bus and Stop requests.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// the fastest of `repeat` runs of the driver, and what it printed
+template <typename Driver>
+static double Time(const Json::Document& document, int repeat, Driver driver, string& output) {
+    double best = numeric_limits<double>::infinity();
+    const auto base_requests = ReadRequests<BaseRequests>(document.GetRoot());
+    const RoutingSettings settings = ReadSettings(document.GetRoot());
+    for (int run = 0; run < repeat; ++run) {
+        RouteManager manager;
+        ProcessRequests(base_requests, manager);
+        ostringstream stream;
+        const auto start = Clock::now();
+        driver(document.GetRoot(), settings, manager, stream);
+        best = min(best, MillisecondsSince(start));
+        output = stream.str();
+    }
+    return best;
+}
+
+static void Compare(const string& title, const Json::Document& document, int repeat) {
+    string sequential_output, pipelined_output;
+    const double sequential_ms = Time(document, repeat, [](const Json::Node& root, const RoutingSettings& settings,
+            RouteManager& manager, ostream& stream) {
+        manager.RunGraphBuilder(settings);
+        PrintResponses(ProcessRequests(ReadRequests<StatRequests>(root), manager), stream);
+    }, sequential_output);
+    const double pipelined_ms = Time(document, repeat, [](const Json::Node& root, const RoutingSettings& settings,
+            RouteManager& manager, ostream& stream) {
+        BuildAndAnswer(root, settings, manager, stream);
+    }, pipelined_output);
+
+    size_t routed = 0;
+    const auto requests = ReadRequests<StatRequests>(document.GetRoot());
+    for (const auto& request : requests) {
+        routed += NeedsRouter(request);
+    }
+    cout << title << " stat_requests: " << requests.size() << " needing_router: " << routed
+         << " sequential_ms: " << sequential_ms
+         << " pipelined_ms: " << pipelined_ms
+         << " speedup: " << sequential_ms / pipelined_ms
+         << " same_output: " << (sequential_output == pipelined_output ? "yes" : "no") << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        Compare("input4", document, 20);
+    }
+    {
+        NetworkConfig config;
+        config.stop_count = 5000;
+        config.route_count = 500;
+        config.route_length = 15;
+        QueryMix mix;
+        mix.bus_count = 50000;
+        mix.stop_count = 50000;
+        mix.route_count = 2000;
+        ostringstream text;
+        GenerateNetwork(config, mix).WriteJson(text, "\"bus_wait_time\": 6, \"bus_velocity\": 40, \"router\": \"dijkstra\"");
+        istringstream input(text.str());
+        const Json::Document document = Json::Load(input);
+        Compare("synthetic_5000", document, 5);
+    }
+}
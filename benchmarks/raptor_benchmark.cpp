@@ -0,0 +1,116 @@
+// RAPTOR against the graph-based Dijkstra: build time, heap held by the
+// routing structures, and Route / ParetoRoute query latency.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static size_t HeapInUse() {
+    return mallinfo2().uordblks;
+}
+
+void Compare(const string& title, const vector<string>& stop_names, RoutingSettings settings,
+        const function<void(RouteManager&)>& load) {
+    const int query_count = 1000;
+    vector<pair<string, string>> queries;
+    mt19937 rng(7);
+    for (int i = 0; i < query_count; ++i) {
+        queries.emplace_back(stop_names[rng() % stop_names.size()], stop_names[rng() % stop_names.size()]);
+    }
+
+    vector<double> dijkstra_times;
+    for (RouterMode mode : {RouterMode::DIJKSTRA, RouterMode::RAPTOR}) {
+        settings.router = mode;
+        const string name = mode == RouterMode::RAPTOR ? "raptor" : "dijkstra";
+        // a fresh manager per mode, so the heap delta holds only its structures
+        RouteManager manager;
+        load(manager);
+        const size_t heap_before = HeapInUse();
+        auto start = Clock::now();
+        manager.RunGraphBuilder(settings);
+        const double build_ms = MillisecondsSince(start);
+        const size_t heap_bytes = HeapInUse() - heap_before;
+
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const double total_time = manager.ReadRouteSearch(queries[i].first, queries[i].second, i).total_time;
+            if (mode == RouterMode::DIJKSTRA) {
+                dijkstra_times.push_back(total_time);
+            } else {
+                mismatches += abs(total_time - dijkstra_times[i]) > 1e-6;
+            }
+        }
+        const double route_us = MillisecondsSince(start) * 1000 / query_count;
+
+        size_t journeys = 0;
+        start = Clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto response = manager.ReadParetoRoute(queries[i].first, queries[i].second, i);
+            journeys += response.journeys ? response.journeys->size() : 0;
+        }
+        const double pareto_us = MillisecondsSince(start) * 1000 / query_count;
+
+        cout << title << " " << name
+             << " build_ms: " << build_ms
+             << " heap_mb: " << heap_bytes / (1024.0 * 1024)
+             << " route_us: " << route_us
+             << " pareto_us: " << pareto_us
+             << " avg_journeys: " << static_cast<double>(journeys) / query_count
+             << " mismatches: " << mismatches << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    {
+        ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+        const Json::Document document = Json::Load(input);
+        RoutingSettings settings = ReadSettings(document.GetRoot());
+        settings.layout = GraphLayout::SPATIAL;
+
+        const auto requests = ReadRequests<BaseRequests>(document.GetRoot());
+        vector<string> stop_names;
+        for (const auto& request : requests) {
+            if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+                stop_names.push_back(add_stop->stop);
+            }
+        }
+        Compare("input4", stop_names, settings, [&requests](RouteManager& manager) {
+            ProcessRequests(requests, manager);
+        });
+    }
+    for (size_t stop_count : {2000, 20000}) {
+        NetworkConfig config;
+        config.stop_count = stop_count;
+        config.route_count = stop_count / 8;
+        config.route_length = 16;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        set<string> served;
+        for (const auto& route : network.routes) {
+            served.insert(route.stops.begin(), route.stops.end());
+        }
+        const vector<string> stop_names(served.begin(), served.end());
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        Compare("synthetic_" + to_string(stop_count), stop_names, settings, [&network](RouteManager& manager) {
+            network.LoadInto(manager);
+        });
+    }
+}
@@ -0,0 +1,54 @@
+// Parsing, dispatching and printing 1M stat requests over a small network,
+// where the per-request overhead rather than route search dominates.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 500;
+    config.route_count = 50;
+    QueryMix mix;
+    mix.bus_count = 450000;
+    mix.stop_count = 450000;
+    mix.route_count = 100000;
+
+    ostringstream text;
+    GenerateNetwork(config, mix).WriteJson(text);
+    const Json::Document document = Json::Load(text.str());
+
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+
+    auto start = Clock::now();
+    const auto requests = ReadRequests<StatRequests>(document.GetRoot());
+    const double parse_ms = MillisecondsSince(start);
+
+    start = Clock::now();
+    const auto responses = ProcessRequests(requests, manager);
+    const double process_ms = MillisecondsSince(start);
+
+    start = Clock::now();
+    ostringstream output;
+    PrintResponses(responses, output);
+    const double print_ms = MillisecondsSince(start);
+
+    cout << "requests: " << requests.size()
+         << " parse_ms: " << parse_ms
+         << " process_ms: " << process_ms
+         << " print_ms: " << print_ms
+         << " output_bytes: " << output.str().size() << "\n";
+}
@@ -0,0 +1,94 @@
+// Route requests answered one by one against grouped by source stop, on
+// query logs whose sources repeat with a Zipf distribution. The printed
+// responses of both runs are compared byte for byte.
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unordered_set>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// sources drawn by rank with weight 1 / rank^skew (0 is uniform)
+vector<StatRequest> MakeLog(const vector<string>& stops, size_t count, double skew, uint32_t seed) {
+    mt19937 rng(seed);
+    vector<double> weights(stops.size());
+    for (size_t rank = 0; rank < stops.size(); ++rank) {
+        weights[rank] = 1 / pow(rank + 1, skew);
+    }
+    discrete_distribution<size_t> source(weights.begin(), weights.end());
+    vector<string> ranked = stops;
+    shuffle(ranked.begin(), ranked.end(), rng);
+
+    vector<StatRequest> log;
+    for (size_t i = 0; i < count; ++i) {
+        ReadRouteSearchRequest request;
+        request.from = ranked[source(rng)];
+        request.to = stops[rng() % stops.size()];
+        request.request_id = static_cast<int>(i);
+        log.push_back(move(request));
+    }
+    return log;
+}
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 20000;
+    config.route_count = 2500;
+    config.route_length = 16;
+    const SyntheticNetwork network = GenerateNetwork(config);
+    RouteManager manager;
+    network.LoadInto(manager);
+    RoutingSettings settings{6, 40 * 1000.0 / 60};
+    settings.layout = GraphLayout::SPATIAL;
+    settings.router = RouterMode::DIJKSTRA;
+    manager.RunGraphBuilder(settings);
+
+    set<string> served;
+    for (const auto& route : network.routes) {
+        served.insert(route.stops.begin(), route.stops.end());
+    }
+    const vector<string> stops(served.begin(), served.end());
+
+    const size_t query_count = 2000;
+    for (const double skew : {0.0, 0.8, 1.0, 1.2}) {
+        const auto log = MakeLog(stops, query_count, skew, 7);
+        unordered_set<string> sources;
+        for (const auto& request : log) {
+            sources.insert(get<ReadRouteSearchRequest>(request).from);
+        }
+
+        auto start = Clock::now();
+        vector<Response> single;
+        for (const auto& request : log) {
+            single.push_back(ProcessRequest(request, manager));
+        }
+        const double single_ms = MillisecondsSince(start);
+        start = Clock::now();
+        const vector<Response> grouped = ProcessRequests(log, manager);
+        const double grouped_ms = MillisecondsSince(start);
+
+        ostringstream single_output, grouped_output;
+        PrintResponses(single, single_output);
+        PrintResponses(grouped, grouped_output);
+        cout << "skew: " << skew
+             << " sources: " << sources.size()
+             << " avg_group: " << static_cast<double>(query_count) / sources.size()
+             << " single_ms: " << single_ms
+             << " grouped_ms: " << grouped_ms
+             << " speedup: " << single_ms / grouped_ms
+             << " identical: " << (single_output.str() == grouped_output.str() ? "yes" : "no") << "\n";
+    }
+}
@@ -0,0 +1,132 @@
+// Load generator for the resident server: several clients pipeline Route,
+// Bus and Stop requests over a Unix socket; reports p50/p99 latency and QPS.
+#include "json.h"
+#include "request.h"
+#include "route_manager.h"
+#include "server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// stat requests of the input with the "id" field cut off, ready to get a fresh id appended
+vector<string> LoadRequestTemplates(const Json::Node& root) {
+    vector<string> result;
+    for (const auto& node : root.AsMap().at("stat_requests").AsArray()) {
+        const auto& map = node.AsMap();
+        const auto& type = map.at("type").AsString();
+        ostringstream line;
+        line << "{\"type\": \"" << type << "\", ";
+        if (type == "Route") {
+            line << "\"from\": \"" << map.at("from").AsString() << "\", \"to\": \"" << map.at("to").AsString() << "\", ";
+        } else {
+            line << "\"name\": \"" << map.at("name").AsString() << "\", ";
+        }
+        line << "\"id\": ";
+        result.push_back(line.str());
+    }
+    return result;
+}
+
+int Connect(const string& path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    copy(path.begin(), path.end(), address.sun_path);
+    while (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return fd;
+}
+
+// sends request_count requests keeping `window` of them in flight, returns latencies in us
+vector<double> RunClient(const string& path, const vector<string>& templates, int client, int request_count, int window) {
+    const int fd = Connect(path);
+    unordered_map<int, Clock::time_point> sent;
+    vector<double> latencies;
+    string buffer;
+    int next = 0;
+    while (static_cast<int>(latencies.size()) < request_count) {
+        string batch;
+        while (next < request_count && static_cast<int>(sent.size()) < window) {
+            const int id = client * request_count + next;
+            batch += templates[next % templates.size()] + to_string(id) + "}\n";
+            sent[id] = Clock::now();
+            ++next;
+        }
+        for (size_t written = 0; written < batch.size(); ) {
+            written += write(fd, batch.data() + written, batch.size() - written);
+        }
+        char chunk[1 << 16];
+        const ssize_t size = read(fd, chunk, sizeof(chunk));
+        if (size <= 0) {
+            break;
+        }
+        buffer.append(chunk, size);
+        for (size_t end; (end = buffer.find('\n')) != string::npos; buffer.erase(0, end + 1)) {
+            const size_t pos = buffer.find("\"request_id\": ");
+            const int id = stoi(buffer.substr(pos + 14));
+            latencies.push_back(chrono::duration<double, micro>(Clock::now() - sent.at(id)).count());
+            sent.erase(id);
+        }
+    }
+    close(fd);
+    return latencies;
+}
+
+int main(int argc, char* argv[]) {
+    ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+    const Json::Document document = Json::Load(input);
+    const SnapshotStore store(ReadRequests<BaseRequests>(document.GetRoot()), ReadSettings(document.GetRoot()));
+    const vector<string> templates = LoadRequestTemplates(document.GetRoot());
+
+    const string path = "/tmp/transport_server_benchmark.sock";
+    for (size_t workers : {1, 2, 4}) {
+        for (int clients : {1, 4, 16}) {
+            ServerOptions options;
+            options.socket_path = path;
+            options.worker_count = workers;
+            options.queue_capacity = 256;
+            RequestServer server(store, options);
+            thread server_thread([&server] { server.Run(); });
+
+            const int request_count = 20000 / clients;
+            vector<vector<double>> results(clients);
+            const auto start = Clock::now();
+            vector<thread> threads;
+            for (int client = 0; client < clients; ++client) {
+                threads.emplace_back([&, client] {
+                    results[client] = RunClient(path, templates, client, request_count, 32);
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            const double seconds = chrono::duration<double>(Clock::now() - start).count();
+            server.Stop();
+            server_thread.join();
+
+            vector<double> latencies;
+            for (const auto& result : results) {
+                latencies.insert(latencies.end(), result.begin(), result.end());
+            }
+            sort(latencies.begin(), latencies.end());
+            cout << "workers: " << workers << " clients: " << clients
+                 << " requests: " << latencies.size()
+                 << " qps: " << static_cast<int>(latencies.size() / seconds)
+                 << " p50_us: " << latencies[latencies.size() / 2]
+                 << " p99_us: " << latencies[latencies.size() * 99 / 100] << "\n";
+        }
+    }
+}
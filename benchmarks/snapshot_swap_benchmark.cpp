@@ -0,0 +1,122 @@
+// Route latency while the network is rebuilt over and over: reader threads
+// query for a fixed time while a writer rebuilds from the same base data
+// with alternating settings. Compares no rebuilds, rebuilds published by
+// SnapshotStore, and rebuilds in place behind a reader-writer lock, which
+// is what RunGraphBuilder on a live RouteManager amounts to.
+#include "json.h"
+#include "request.h"
+#include "route_manager.h"
+#include "snapshot_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// runs the readers for `duration` next to `rebuild`, called in a loop
+// meanwhile; returns the rebuild count
+static size_t Stress(const string& title, size_t reader_count, chrono::milliseconds duration,
+        const vector<string>& stop_names, const function<void(const string&, const string&)>& query,
+        const function<void(size_t)>& rebuild) {
+    vector<vector<double>> latencies(reader_count);
+    vector<thread> readers;
+    const auto start = Clock::now();
+    for (size_t reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&, reader] {
+            mt19937 rng(static_cast<unsigned>(reader));
+            // readers stop on time of their own: a reader-preferring lock
+            // may keep the writer waiting for all of it
+            while (Clock::now() - start < duration) {
+                const auto query_start = Clock::now();
+                query(stop_names[rng() % stop_names.size()], stop_names[rng() % stop_names.size()]);
+                latencies[reader].push_back(MillisecondsSince(query_start) * 1000);
+            }
+        });
+    }
+    size_t rebuilds = 0;
+    double rebuild_ms = 0;
+    while (Clock::now() - start < duration) {
+        if (rebuild) {
+            const auto rebuild_start = Clock::now();
+            rebuild(rebuilds++);
+            rebuild_ms += MillisecondsSince(rebuild_start);
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    const double seconds = MillisecondsSince(start) / 1000;
+
+    vector<double> all;
+    for (const auto& reader : latencies) {
+        all.insert(all.end(), reader.begin(), reader.end());
+    }
+    sort(all.begin(), all.end());
+    cout << title << " readers: " << reader_count
+         << " rebuilds: " << rebuilds
+         << " avg_rebuild_ms: " << (rebuilds ? rebuild_ms / rebuilds : 0)
+         << " qps: " << static_cast<int>(all.size() / seconds)
+         << " p50_us: " << all[all.size() / 2]
+         << " p99_us: " << all[all.size() * 99 / 100]
+         << " p999_us: " << all[all.size() * 999 / 1000]
+         << " max_us: " << all.back() << "\n";
+    return rebuilds;
+}
+
+int main(int argc, char* argv[]) {
+    ifstream input(argc > 1 ? argv[1] : "../input/input4.json");
+    const Json::Document document = Json::Load(input);
+    const auto base_requests = ReadRequests<BaseRequests>(document.GetRoot());
+    const RoutingSettings settings = ReadSettings(document.GetRoot());
+    vector<string> stop_names;
+    for (const auto& request : base_requests) {
+        if (const auto* add_stop = get_if<AddStopRequest>(&request)) {
+            stop_names.push_back(add_stop->stop);
+        }
+    }
+    // every other rebuild waits a minute longer
+    auto settings_for = [&settings](size_t rebuild) {
+        RoutingSettings result = settings;
+        result.bus_wait_time += rebuild % 2;
+        return result;
+    };
+    const auto duration = chrono::milliseconds(2000);
+
+    for (const size_t reader_count : {1, 2, 4}) {
+        SnapshotStore store(base_requests, settings);
+        auto read_snapshot = [&store](const string& from, const string& to) {
+            store.Get()->manager.ReadRouteSearch(from, to, 0);
+        };
+        Stress("no_rebuilds", reader_count, duration, stop_names, read_snapshot, nullptr);
+        Stress("snapshot_swap", reader_count, duration, stop_names, read_snapshot, [&](size_t rebuild) {
+            store.Rebuild(base_requests, settings_for(rebuild));
+            store.Wait();
+        });
+
+        RouteManager manager;
+        ProcessRequests(base_requests, manager);
+        manager.RunGraphBuilder(settings);
+        shared_mutex manager_mutex;
+        Stress("in_place", reader_count, duration, stop_names, [&](const string& from, const string& to) {
+            shared_lock lock(manager_mutex);
+            manager.ReadRouteSearch(from, to, 0);
+        }, [&](size_t rebuild) {
+            unique_lock lock(manager_mutex);
+            manager.RunGraphBuilder(settings_for(rebuild));
+        });
+    }
+}
@@ -0,0 +1,129 @@
+// Grid index over 100k stops: build time, k-nearest latency against a
+// linear scan, and point-to-point Route queries seeded from nearby stops.
+#include "network_generator.h"
+#include "route_manager.h"
+#include "stop_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static vector<uint32_t> LinearNearest(const vector<Coordinate>& coordinates, const Coordinate& point, size_t count) {
+    vector<pair<double, uint32_t>> all;
+    all.reserve(coordinates.size());
+    for (uint32_t stop = 0; stop < coordinates.size(); ++stop) {
+        all.emplace_back(DistanceBetweenCoordinates(point, coordinates[stop]), stop);
+    }
+    partial_sort(all.begin(), all.begin() + count, all.end());
+    vector<uint32_t> result;
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(all[i].second);
+    }
+    return result;
+}
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 100000;
+    config.route_count = 10000;
+    config.route_length = 12;
+    const SyntheticNetwork network = GenerateNetwork(config);
+
+    vector<Coordinate> coordinates;
+    double min_lat = 90, max_lat = -90, min_lon = 180, max_lon = -180;
+    for (const auto& stop : network.stops) {
+        coordinates.push_back({stop.lat, stop.lon});
+        min_lat = min(min_lat, stop.lat);
+        max_lat = max(max_lat, stop.lat);
+        min_lon = min(min_lon, stop.lon);
+        max_lon = max(max_lon, stop.lon);
+    }
+    auto start = Clock::now();
+    const StopIndex index(coordinates);
+    cout << "stops: " << coordinates.size() << " cells: " << index.GetCellCount()
+         << " build_ms: " << MillisecondsSince(start) << "\n";
+
+    mt19937 rng(7);
+    uniform_real_distribution<double> lat(min_lat, max_lat), lon(min_lon, max_lon);
+    vector<Coordinate> points(100000);
+    for (auto& point : points) {
+        point = {lat(rng), lon(rng)};
+    }
+    for (const size_t k : {1, 8, 32}) {
+        start = Clock::now();
+        size_t checksum = 0;
+        for (const auto& point : points) {
+            checksum += index.FindNearest(point, k).back().first;
+        }
+        const double grid_us = MillisecondsSince(start) * 1000 / points.size();
+
+        const size_t linear_count = 200;
+        size_t mismatches = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < linear_count; ++i) {
+            const auto expected = LinearNearest(coordinates, points[i], k);
+            const auto found = index.FindNearest(points[i], k);
+            for (size_t j = 0; j < k; ++j) {
+                mismatches += found[j].first != expected[j];
+            }
+        }
+        const double linear_us = MillisecondsSince(start) * 1000 / linear_count;
+        cout << "k: " << k << " grid_query_us: " << grid_us << " linear_query_us: " << linear_us
+             << " mismatches: " << mismatches << " checksum: " << checksum << "\n";
+    }
+
+    RouteManager manager;
+    network.LoadInto(manager);
+    RoutingSettings settings{6, 40 * 1000.0 / 60};
+    settings.layout = GraphLayout::SPATIAL;
+    settings.router = RouterMode::DIJKSTRA;
+    start = Clock::now();
+    manager.RunGraphBuilder(settings);
+    cout << "graph_build_ms: " << MillisecondsSince(start) << "\n";
+
+    // routes cover only part of the stops, so trips start and end within
+    // about 100 m of a served stop
+    vector<Coordinate> served;
+    for (const auto& route : network.routes) {
+        for (const auto& name : route.stops) {
+            const auto& stop = network.stops[stoul(name.substr(1))];
+            served.push_back({stop.lat, stop.lon});
+        }
+    }
+    uniform_real_distribution<double> offset(-0.001, 0.001);
+    vector<Coordinate> ends(400);
+    for (auto& end : ends) {
+        const Coordinate& stop = served[rng() % served.size()];
+        end = {stop.lat + offset(rng), stop.lon + offset(rng)};
+    }
+
+    const int query_count = 200;
+    for (const size_t access : {1, 4, 8, 16}) {
+        settings.access_stop_count = access;
+        manager.RunGraphBuilder(settings);
+        size_t found = 0, walks = 0;
+        double travel = 0;
+        start = Clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto response = manager.ReadRouteSearchBetween(ends[2 * i], ends[2 * i + 1], i);
+            if (response.stats) {
+                ++found;
+                travel += response.total_time;
+                walks += response.stats->size() == 1;
+            }
+        }
+        cout << "access_stops: " << access
+             << " avg_route_ms: " << MillisecondsSince(start) / query_count
+             << " found: " << found
+             << " avg_travel_min: " << travel / max<size_t>(found, 1)
+             << " walk_only: " << walks << "\n";
+    }
+}
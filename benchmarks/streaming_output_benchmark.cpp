@@ -0,0 +1,103 @@
+// Peak memory and wall time of answering a large stat request batch with
+// every response held until the end and printed then, against responses
+// streamed out by a writer thread a window at a time. Each mode runs in a
+// child process of its own, so its peak RSS is its own.
+#include "json.h"
+#include "network_generator.h"
+#include "request.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+struct Run {
+    double wall_ms;
+    long max_rss_kb;
+};
+
+// loads the input, answers it into output_path and reports the time taken
+// from loading to the last byte written, in a child process
+static Run RunChild(const string& input_path, const string& output_path, size_t stream_window) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        throw runtime_error("cannot create pipe");
+    }
+    const pid_t child = fork();
+    if (child == 0) {
+        close(pipe_fds[0]);
+        const auto start = Clock::now();
+        ifstream input(input_path);
+        const Json::Document document = Json::Load(input);
+        RouteManager manager;
+        ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+        {
+            ofstream output(output_path);
+            BuildAndAnswer(document.GetRoot(), ReadSettings(document.GetRoot()), manager, output, stream_window);
+        }
+        const double wall_ms = MillisecondsSince(start);
+        [[maybe_unused]] auto written = write(pipe_fds[1], &wall_ms, sizeof(wall_ms));
+        _exit(0);
+    }
+    close(pipe_fds[1]);
+    Run run{0, 0};
+    [[maybe_unused]] auto size = read(pipe_fds[0], &run.wall_ms, sizeof(run.wall_ms));
+    close(pipe_fds[0]);
+    int status = 0;
+    rusage usage{};
+    wait4(child, &status, 0, &usage);
+    run.max_rss_kb = usage.ru_maxrss;
+    return run;
+}
+
+static string ReadFile(const string& path) {
+    ifstream input(path);
+    return {istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+}
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 2000;
+    config.route_count = 200;
+    config.route_length = 15;
+    const string input_path = "/tmp/streaming_output_benchmark_input.json";
+    for (const size_t route_count : {20000, 100000}) {
+        QueryMix mix;
+        mix.bus_count = route_count / 10;
+        mix.stop_count = route_count / 10;
+        mix.route_count = route_count;
+        {
+            ofstream input(input_path);
+            GenerateNetwork(config, mix).WriteJson(input, "\"bus_wait_time\": 6, \"bus_velocity\": 40, \"router\": \"dijkstra\"");
+        }
+        const string held_path = "/tmp/streaming_output_benchmark_held.json";
+        const string streamed_path = "/tmp/streaming_output_benchmark_streamed.json";
+        const Run held = RunChild(input_path, held_path, 0);
+        const size_t output_bytes = ReadFile(held_path).size();
+        for (const size_t window : {0, 256, 1024, 8192}) {
+            const Run run = window == 0 ? held : RunChild(input_path, streamed_path, window);
+            cout << "route_requests: " << route_count
+                 << " output_mb: " << output_bytes / 1048576.0
+                 << (window == 0 ? " held" : " streamed window: " + to_string(window))
+                 << " wall_ms: " << run.wall_ms
+                 << " max_rss_mb: " << run.max_rss_kb / 1024.0;
+            if (window != 0) {
+                cout << " same_output: " << (ReadFile(streamed_path) == ReadFile(held_path) ? "yes" : "no");
+            }
+            cout << "\n";
+        }
+    }
+}
@@ -0,0 +1,73 @@
+// Connection Scan over a synthetic full-day timetable: build time, size of
+// the connection array and latency of "depart at T" Route queries.
+#include "network_generator.h"
+#include "route_manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+    const int query_count = 1000;
+    for (double headway : {15.0, 5.0}) {
+        NetworkConfig config;
+        config.stop_count = 20000;
+        config.route_count = 2500;
+        config.route_length = 16;
+        config.headway = headway;
+        const SyntheticNetwork network = GenerateNetwork(config);
+        RouteManager manager;
+        network.LoadInto(manager);
+
+        RoutingSettings settings{6, 40 * 1000.0 / 60};
+        settings.layout = GraphLayout::SPATIAL;
+        settings.router = RouterMode::RAPTOR;
+        size_t connection_count = 0;
+        for (const auto& route : network.routes) {
+            const size_t stops = route.is_roundtrip ? route.stops.size() : 2 * route.stops.size() - 1;
+            connection_count += (stops - 1) * route.departures.size();
+        }
+        auto start = Clock::now();
+        manager.RunGraphBuilder(settings);
+        const double build_ms = MillisecondsSince(start);
+
+        set<string> served;
+        for (const auto& route : network.routes) {
+            served.insert(route.stops.begin(), route.stops.end());
+        }
+        const vector<string> stop_names(served.begin(), served.end());
+        mt19937 rng(7);
+        uniform_real_distribution<double> departure(6 * 60, 22 * 60);
+
+        size_t found = 0, scanned = 0;
+        double travel = 0;
+        start = Clock::now();
+        for (int i = 0; i < query_count; ++i) {
+            const auto& from = stop_names[rng() % stop_names.size()];
+            const auto& to = stop_names[rng() % stop_names.size()];
+            const auto response = manager.ReadRouteSearchAt(from, to, i, round(departure(rng)));
+            scanned += Timetable::LastScannedConnections();
+            if (response.stats) {
+                ++found;
+                travel += response.total_time;
+            }
+        }
+        const double query_ms = MillisecondsSince(start) / query_count;
+        cout << "headway: " << headway
+             << " connections: " << connection_count
+             << " build_ms: " << build_ms
+             << " avg_scanned: " << scanned / query_count
+             << " avg_query_ms: " << query_ms
+             << " scanned_per_ms: " << scanned / query_count / query_ms
+             << " found: " << found
+             << " avg_travel_min: " << travel / max<size_t>(found, 1) << "\n";
+    }
+}
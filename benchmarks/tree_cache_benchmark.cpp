@@ -0,0 +1,86 @@
+// Route queries replayed from a log whose sources follow a Zipf
+// distribution: a Dijkstra search per query against shortest path trees
+// cached per source under several memory budgets. Reports the hit ratio
+// and the mean and tail latency, and checks that the answers agree.
+#include "network_generator.h"
+#include "route_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+    NetworkConfig config;
+    config.stop_count = 20000;
+    config.route_count = 2500;
+    config.route_length = 16;
+    const SyntheticNetwork network = GenerateNetwork(config);
+    RouteManager manager;
+    network.LoadInto(manager);
+
+    set<string> served;
+    for (const auto& route : network.routes) {
+        served.insert(route.stops.begin(), route.stops.end());
+    }
+    vector<string> stops(served.begin(), served.end());
+
+    // sources drawn by rank with weight 1 / rank
+    mt19937 rng(7);
+    vector<double> weights(stops.size());
+    for (size_t rank = 0; rank < stops.size(); ++rank) {
+        weights[rank] = 1.0 / (rank + 1);
+    }
+    discrete_distribution<size_t> source(weights.begin(), weights.end());
+    vector<string> ranked = stops;
+    shuffle(ranked.begin(), ranked.end(), rng);
+    const size_t query_count = 3000;
+    vector<pair<string, string>> queries;
+    for (size_t i = 0; i < query_count; ++i) {
+        queries.emplace_back(ranked[source(rng)], stops[rng() % stops.size()]);
+    }
+
+    RoutingSettings settings{6, 40 * 1000.0 / 60};
+    settings.layout = GraphLayout::SPATIAL;
+    vector<double> expected;
+    for (const size_t megabytes : {0, 4, 16, 64, 256}) {
+        settings.router = megabytes == 0 ? RouterMode::DIJKSTRA : RouterMode::TREE_CACHE;
+        settings.tree_cache_bytes = megabytes << 20;
+        manager.RunGraphBuilder(settings);
+
+        vector<double> latencies, times;
+        const auto start = Clock::now();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto query_start = Clock::now();
+            const auto response = manager.ReadRouteSearch(queries[i].first, queries[i].second, static_cast<int>(i));
+            latencies.push_back(MillisecondsSince(query_start));
+            times.push_back(response.stats ? response.total_time : -1);
+        }
+        const double total_ms = MillisecondsSince(start);
+        if (expected.empty()) {
+            expected = times;
+        }
+        size_t mismatches = 0;
+        for (size_t i = 0; i < times.size(); ++i) {
+            mismatches += times[i] != expected[i];
+        }
+        sort(latencies.begin(), latencies.end());
+        const auto stats = manager.GetTreeCacheStats();
+        cout << (megabytes == 0 ? "dijkstra" : "tree_cache_mb: " + to_string(megabytes))
+             << " hit_ratio: " << static_cast<double>(stats.hits) / max<size_t>(stats.hits + stats.misses, 1)
+             << " evictions: " << stats.evictions
+             << " avg_query_ms: " << total_ms / queries.size()
+             << " p50_ms: " << latencies[latencies.size() / 2]
+             << " p99_ms: " << latencies[latencies.size() * 99 / 100]
+             << " mismatches: " << mismatches << "\n";
+    }
+}
@@ -0,0 +1,171 @@
+// Floating-point against fixed-point integer edge weights: heap operations
+// of a binary heap and the radix heap, and Dijkstra queries on the same
+// transit graph weighted both ways.
+#include "network_generator.h"
+#include "path_search.h"
+#include "search_queue.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <random>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// 40 km/h in meters per minute, and the fixed-point units per minute
+static const double VELOCITY = 40 * 1000.0 / 60;
+static const double UNITS_PER_MINUTE = VELOCITY * 60;
+
+// keeps the heap benchmark from being optimized away
+static volatile double checksum_sink;
+
+// a number of fixed-point units as a weight of either type
+template <typename Weight>
+Weight FromUnits(uint32_t units) {
+    if constexpr (is_integral_v<Weight>) {
+        return units;
+    } else {
+        return units / UNITS_PER_MINUTE;
+    }
+}
+
+// pops the minimum and pushes a later key, as a search does
+template <typename Weight, typename Queue>
+double RunHeap(Queue& queue, const vector<uint32_t>& increments, size_t preload) {
+    const auto start = Clock::now();
+    for (size_t i = 0; i < preload; ++i) {
+        queue.push(FromUnits<Weight>(increments[i]), static_cast<uint32_t>(i));
+    }
+    Weight checksum = 0;
+    for (size_t i = preload; i < increments.size(); ++i) {
+        const auto [key, value] = queue.pop();
+        checksum += key;
+        queue.push(key + FromUnits<Weight>(increments[i]), value);
+    }
+    const double ms = MillisecondsSince(start);
+    checksum_sink = checksum;
+    return ms;
+}
+
+// binary heap as the search used it before
+struct PriorityQueue {
+    using Item = pair<double, uint32_t>;
+    priority_queue<Item, vector<Item>, greater<Item>> queue;
+    void push(double key, uint32_t value) {
+        queue.push({key, value});
+    }
+    Item pop() {
+        const Item item = queue.top();
+        queue.pop();
+        return item;
+    }
+};
+
+// wait and ride edges of every route, as the route manager builds them
+template <typename Weight>
+Graph::DirectedWeightedGraph<Weight> BuildGraph(const SyntheticNetwork& network, Weight wait,
+        Weight (*ride)(int meters)) {
+    map<string, size_t> ids;
+    for (const auto& stop : network.stops) {
+        ids.emplace(stop.name, ids.size());
+    }
+    map<pair<size_t, size_t>, int> roads;
+    for (const auto& stop : network.stops) {
+        for (const auto& [meters, other] : stop.road_distances) {
+            roads[{ids[stop.name], ids[other]}] = meters;
+            roads.emplace(make_pair(ids[other], ids[stop.name]), meters);
+        }
+    }
+    vector<Graph::Edge<Weight>> edges;
+    for (const auto& route : network.routes) {
+        vector<size_t> stops;
+        for (const auto& name : route.stops) {
+            stops.push_back(ids[name]);
+        }
+        for (int direction = 0; direction < 2; ++direction) {
+            for (size_t i = 0; i < stops.size(); ++i) {
+                edges.push_back({2 * stops[i], 2 * stops[i] + 1, wait});
+                int meters = 0;
+                for (size_t j = i + 1; j < stops.size(); ++j) {
+                    meters += roads.at({stops[j - 1], stops[j]});
+                    edges.push_back({2 * stops[i] + 1, 2 * stops[j], ride(meters)});
+                }
+            }
+            reverse(stops.begin(), stops.end());
+        }
+    }
+    return Graph::DirectedWeightedGraph<Weight>(2 * network.stops.size(), move(edges));
+}
+
+template <typename Weight>
+vector<double> RunQueries(const Graph::DirectedWeightedGraph<Weight>& graph, const vector<pair<size_t, size_t>>& queries,
+        double minutes_per_unit) {
+    const Graph::PathSearch<Weight> search(graph);
+    vector<double> times;
+    size_t settled = 0;
+    const auto start = Clock::now();
+    for (const auto& [from, to] : queries) {
+        const auto path = search.FindPath(2 * from, 2 * to);
+        times.push_back(path ? path->weight * minutes_per_unit : -1);
+        settled += Graph::PathSearch<Weight>::LastStats().settled_vertices;
+    }
+    cout << (is_integral_v<Weight> ? "int64 " : "double") << " avg_query_us: "
+         << MillisecondsSince(start) * 1000 / queries.size()
+         << " avg_settled: " << settled / queries.size() << "\n";
+    return times;
+}
+
+int main() {
+    mt19937 rng(7);
+    // up to 2 km of riding between pops, in fixed-point units
+    uniform_int_distribution<uint32_t> increment(0, 2000 * 60);
+    vector<uint32_t> increments(4'000'000);
+    for (auto& value : increments) {
+        value = increment(rng);
+    }
+    for (const size_t preload : {1000, 100000}) {
+        PriorityQueue binary_before;
+        Graph::SearchQueue<double, uint32_t> binary;
+        Graph::SearchQueue<int64_t, uint32_t> radix;
+        const size_t ops = increments.size() - preload;
+        cout << "heap_size: " << preload
+             << " priority_queue_ns: " << RunHeap<double>(binary_before, increments, preload) * 1e6 / ops
+             << " binary_ns: " << RunHeap<double>(binary, increments, preload) * 1e6 / ops
+             << " radix_ns: " << RunHeap<int64_t>(radix, increments, preload) * 1e6 / ops << "\n";
+    }
+
+    NetworkConfig config;
+    config.stop_count = 20000;
+    config.route_count = 2500;
+    config.route_length = 16;
+    const SyntheticNetwork network = GenerateNetwork(config);
+    const auto as_double = BuildGraph<double>(network, 6.0, [](int meters) { return meters / VELOCITY; });
+    const auto as_int = BuildGraph<int64_t>(network, llround(6 * UNITS_PER_MINUTE),
+                                            [](int meters) { return int64_t{meters} * 60; });
+    cout << "vertices: " << as_int.GetVertexCount() << " edges: " << as_int.GetEdgeCount() << "\n";
+
+    vector<size_t> served;
+    for (const auto& route : network.routes) {
+        for (const auto& name : route.stops) {
+            served.push_back(stoul(name.substr(1)));
+        }
+    }
+    vector<pair<size_t, size_t>> queries(2000);
+    for (auto& query : queries) {
+        query = {served[rng() % served.size()], served[rng() % served.size()]};
+    }
+    const auto double_times = RunQueries(as_double, queries, 1);
+    const auto int_times = RunQueries(as_int, queries, 1 / UNITS_PER_MINUTE);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        mismatches += abs(double_times[i] - int_times[i]) > 1e-9 * max(1.0, double_times[i]);
+    }
+    cout << "mismatches: " << mismatches << "\n";
+}
@@ -0,0 +1,9 @@
+# Runs PROGRAM on INPUT, writing OUTPUT, and fails unless OUTPUT equals EXPECTED.
+execute_process(COMMAND ${PROGRAM} ${INPUT} ${OUTPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${PROGRAM} exited with ${result}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}")
+endif()
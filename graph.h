@@ -2,6 +2,8 @@
 
 #include <cstdlib>
 #include <deque>
+#include <iterator>
+#include <utility>
 #include <vector>
 
 template <typename It>
@@ -38,30 +40,63 @@ namespace Graph {
 
   public:
     DirectedWeightedGraph(size_t vertex_count);
+    // builds the incidence lists (outgoing and incoming) for an already
+    // filled edge array in one pass; edge ids are positions in the array
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // changes the weight only; the topology stays as it is
+    void SetEdgeWeight(EdgeId edge_id, Weight weight);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // edges ending at the vertex, for searches that run backward
+    IncidentEdgesRange GetIncomingEdges(VertexId vertex) const;
 
   private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    std::vector<IncidenceList> reverse_incidence_lists_;
   };
 
 
   template <typename Weight>
-  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) : incidence_lists_(vertex_count) {}
+  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
+      : incidence_lists_(vertex_count), reverse_incidence_lists_(vertex_count) {}
+
+  template <typename Weight>
+  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+      : edges_(std::move(edges)), incidence_lists_(vertex_count), reverse_incidence_lists_(vertex_count) {
+    std::vector<size_t> out_degrees(vertex_count, 0), in_degrees(vertex_count, 0);
+    for (const auto& edge : edges_) {
+      ++out_degrees[edge.from];
+      ++in_degrees[edge.to];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      incidence_lists_[vertex].reserve(out_degrees[vertex]);
+      reverse_incidence_lists_[vertex].reserve(in_degrees[vertex]);
+    }
+    for (EdgeId id = 0; id < edges_.size(); ++id) {
+      incidence_lists_[edges_[id].from].push_back(id);
+      reverse_incidence_lists_[edges_[id].to].push_back(id);
+    }
+  }
 
   template <typename Weight>
   EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_[edge.from].push_back(id);
+    reverse_incidence_lists_[edge.to].push_back(id);
     return id;
   }
 
+  template <typename Weight>
+  void DirectedWeightedGraph<Weight>::SetEdgeWeight(EdgeId edge_id, Weight weight) {
+    edges_[edge_id].weight = weight;
+  }
+
   template <typename Weight>
   size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
     return incidence_lists_.size();
@@ -83,4 +118,60 @@ namespace Graph {
     const auto& edges = incidence_lists_[vertex];
     return {std::begin(edges), std::end(edges)};
   }
+
+  template <typename Weight>
+  typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
+  DirectedWeightedGraph<Weight>::GetIncomingEdges(VertexId vertex) const {
+    const auto& edges = reverse_incidence_lists_[vertex];
+    return {std::begin(edges), std::end(edges)};
+  }
+
+  // Keeps one edge per (from, to): the lightest, the first of equally light
+  // ones, which is the one a search relaxing edges in id order settles on.
+  // The remaining edges keep their order; returns their former ids.
+  template <typename Weight>
+  std::vector<EdgeId> MergeParallelEdges(size_t vertex_count, std::vector<Edge<Weight>>& edges) {
+    // edge ids by source vertex, in id order
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (const auto& edge : edges) {
+      ++offsets[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      offsets[vertex + 1] += offsets[vertex];
+    }
+    std::vector<EdgeId> by_source(edges.size());
+    std::vector<size_t> next = offsets;
+    for (EdgeId id = 0; id < edges.size(); ++id) {
+      by_source[next[edges[id].from]++] = id;
+    }
+
+    std::vector<char> keep(edges.size(), 0);
+    std::vector<EdgeId> best(vertex_count);
+    std::vector<VertexId> seen_from(vertex_count, vertex_count);
+    for (VertexId from = 0; from < vertex_count; ++from) {
+      for (size_t i = offsets[from]; i < offsets[from + 1]; ++i) {
+        const EdgeId id = by_source[i];
+        const VertexId to = edges[id].to;
+        if (seen_from[to] != from) {
+          seen_from[to] = from;
+          best[to] = id;
+          keep[id] = 1;
+        } else if (edges[id].weight < edges[best[to]].weight) {
+          keep[best[to]] = 0;
+          best[to] = id;
+          keep[id] = 1;
+        }
+      }
+    }
+
+    std::vector<EdgeId> kept;
+    for (EdgeId id = 0; id < edges.size(); ++id) {
+      if (keep[id]) {
+        edges[kept.size()] = edges[id];
+        kept.push_back(id);
+      }
+    }
+    edges.resize(kept.size());
+    return kept;
+  }
 }
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "graph.h"
+#include "path_search.h"
+#include "search_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Graph {
+
+  // allocates on cache line boundaries
+  template <typename T>
+  struct CacheAlignedAllocator {
+    using value_type = T;
+    static constexpr std::align_val_t ALIGNMENT{64};
+
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+      return static_cast<T*>(::operator new(count * sizeof(T), ALIGNMENT));
+    }
+    void deallocate(T* pointer, size_t) {
+      ::operator delete(pointer, ALIGNMENT);
+    }
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+  };
+
+  // Hub labeling: every vertex v keeps an out-label of hubs h with d(v, h)
+  // and an in-label with d(h, v), such that some hub on a shortest s - t
+  // path is in both the out-label of s and the in-label of t. A query is a
+  // merge of the two labels. Labels are built by pruned Dijkstra searches
+  // (forward and backward) from each vertex in order of importance, an
+  // estimate of how many shortest paths pass through it: a vertex is
+  // labeled only if the hubs so far do not already cover its distance.
+  // Hubs are stored as their rank in that order, so every label is sorted,
+  // in blocks of four padded with sentinels that SSE2 compares at once; the
+  // arrays are aligned to 64-byte cache lines, so no block straddles one.
+  // A label entry also keeps the edge leaving v towards the hub (entering v
+  // from it): the vertex at its other end was labeled with the same hub by
+  // the same search, so paths unpack hop by hop.
+  template <typename Weight>
+  class HubLabels {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using Hub = uint32_t;
+    template <typename T>
+    using AlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+    static constexpr size_t BLOCK = 4;
+    // shortest path trees that rank the vertices
+    static constexpr size_t SAMPLES = 64;
+    // padding of out- and in-labels; they never equal each other or a hub
+    static constexpr Hub OUT_PADDING = std::numeric_limits<Hub>::max();
+    static constexpr Hub IN_PADDING = OUT_PADDING - 1;
+
+  public:
+    explicit HubLabels(const Graph& graph);
+
+    std::optional<Weight> FindDistance(VertexId from, VertexId to) const;
+    std::optional<Path<Weight>> FindPath(VertexId from, VertexId to) const;
+
+    // hubs over all labels of both directions, padding left out
+    size_t GetEntryCount() const {
+      return entry_count_;
+    }
+    size_t GetMemoryUsage() const {
+      size_t bytes = 0;
+      for (const Labels* labels : {&out_, &in_}) {
+        bytes += labels->offsets.capacity() * sizeof(size_t) + labels->hubs.capacity() * sizeof(Hub)
+            + labels->distances.capacity() * sizeof(Weight) + labels->edges.capacity() * sizeof(EdgeId);
+      }
+      return bytes;
+    }
+
+  private:
+    struct Entry {
+      Hub hub;
+      Weight distance;
+      EdgeId edge;
+    };
+
+    // the labels of one direction, vertex after vertex, each starting on a block
+    struct Labels {
+      std::vector<size_t> offsets;
+      AlignedVector<Hub> hubs;
+      AlignedVector<Weight> distances;
+      AlignedVector<EdgeId> edges;
+
+      void Assign(const std::vector<std::vector<Entry>>& labels, Hub padding);
+      size_t Find(VertexId vertex, Hub hub) const;
+    };
+
+    struct Meeting {
+      Weight distance;
+      size_t out_index;
+      size_t in_index;
+    };
+
+    std::optional<Meeting> Meet(VertexId from, VertexId to) const;
+    // pruned search from the hub of the given rank, adding it to the labels it reaches
+    void Grow(Hub rank, Direction direction, std::vector<std::vector<Entry>>& out,
+              std::vector<std::vector<Entry>>& in, std::vector<Weight>& hub_distance) const;
+
+    const Graph& graph_;
+    std::vector<VertexId> order_;
+    Labels out_;
+    Labels in_;
+    size_t entry_count_ = 0;
+  };
+
+
+  template <typename Weight>
+  HubLabels<Weight>::HubLabels(const Graph& graph) : graph_(graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    // Vertices on many shortest paths first: a vertex scores the size of
+    // its subtree in the trees of a sample of sources, ties broken by degree.
+    std::vector<size_t> score(vertex_count), degree(vertex_count);
+    std::vector<VertexId> sources;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      const auto out = graph.GetIncidentEdges(vertex);
+      const auto in = graph.GetIncomingEdges(vertex);
+      degree[vertex] = (out.end() - out.begin() + 1) * (in.end() - in.begin() + 1);
+      if (out.begin() != out.end()) {
+        sources.push_back(vertex);
+      }
+      order_.push_back(vertex);
+    }
+    const PathSearch<Weight> search(graph);
+    const size_t sample_count = std::min(SAMPLES, sources.size());
+    std::vector<size_t> subtree(vertex_count);
+    std::vector<VertexId> reached;
+    for (size_t sample = 0; sample < sample_count; ++sample) {
+      const auto tree = search.BuildTree(sources[sample * sources.size() / sample_count]);
+      reached.clear();
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (tree.Reached(vertex)) {
+          reached.push_back(vertex);
+        }
+      }
+      // farthest first, so subtrees are complete before their roots
+      std::sort(reached.begin(), reached.end(), [&](VertexId lhs, VertexId rhs) {
+        return tree.distance[lhs] > tree.distance[rhs];
+      });
+      std::fill(subtree.begin(), subtree.end(), 0);
+      for (const VertexId vertex : reached) {
+        score[vertex] += ++subtree[vertex];
+        if (const EdgeId edge_id = tree.prev_edge[vertex]; edge_id != ShortestPathTree<Weight>::NO_EDGE) {
+          subtree[graph.GetEdge(edge_id).from] += subtree[vertex];
+        }
+      }
+    }
+    std::stable_sort(order_.begin(), order_.end(), [&](VertexId lhs, VertexId rhs) {
+      return std::tie(score[lhs], degree[lhs]) > std::tie(score[rhs], degree[rhs]);
+    });
+
+    std::vector<std::vector<Entry>> out(vertex_count), in(vertex_count);
+    std::vector<Weight> hub_distance(vertex_count, UNREACHABLE<Weight>);
+    for (Hub rank = 0; rank < vertex_count; ++rank) {
+      Grow(rank, Direction::FORWARD, out, in, hub_distance);
+      Grow(rank, Direction::BACKWARD, out, in, hub_distance);
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      entry_count_ += out[vertex].size() + in[vertex].size();
+    }
+    out_.Assign(out, OUT_PADDING);
+    in_.Assign(in, IN_PADDING);
+  }
+
+  template <typename Weight>
+  void HubLabels<Weight>::Grow(Hub rank, Direction direction, std::vector<std::vector<Entry>>& out,
+                               std::vector<std::vector<Entry>>& in, std::vector<Weight>& hub_distance) const {
+    const VertexId hub = order_[rank];
+    const bool forward = direction == Direction::FORWARD;
+    // a forward search labels in-labels and is pruned by the hub's out-label
+    auto& labeled = forward ? in : out;
+    const auto& hub_label = forward ? out[hub] : in[hub];
+    for (const Entry& entry : hub_label) {
+      hub_distance[entry.hub] = entry.distance;
+    }
+
+    thread_local std::vector<Weight> distance;
+    thread_local std::vector<EdgeId> prev_edge;
+    thread_local std::vector<VertexId> reached;
+    thread_local SearchQueue<Weight, VertexId> queue;
+    distance.resize(graph_.GetVertexCount(), UNREACHABLE<Weight>);
+    prev_edge.resize(graph_.GetVertexCount());
+    queue.clear();
+    distance[hub] = 0;
+    prev_edge[hub] = ShortestPathTree<Weight>::NO_EDGE;
+    reached.push_back(hub);
+    queue.push(0, hub);
+    while (!queue.empty()) {
+      const auto [vertex_distance, vertex] = queue.pop();
+      if (vertex_distance > distance[vertex]) {
+        continue;
+      }
+      // covered already by a more important hub
+      bool covered = false;
+      for (const Entry& entry : labeled[vertex]) {
+        if (hub_distance[entry.hub] != UNREACHABLE<Weight>
+            && hub_distance[entry.hub] + entry.distance <= vertex_distance) {
+          covered = true;
+          break;
+        }
+      }
+      if (covered) {
+        continue;
+      }
+      labeled[vertex].push_back({rank, vertex_distance, prev_edge[vertex]});
+      for (const EdgeId edge_id : forward ? graph_.GetIncidentEdges(vertex) : graph_.GetIncomingEdges(vertex)) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        const VertexId next = forward ? edge.to : edge.from;
+        const Weight candidate = vertex_distance + edge.weight;
+        if (candidate < distance[next]) {
+          if (distance[next] == UNREACHABLE<Weight>) {
+            reached.push_back(next);
+          }
+          distance[next] = candidate;
+          prev_edge[next] = edge_id;
+          queue.push(candidate, next);
+        }
+      }
+    }
+
+    for (const VertexId vertex : reached) {
+      distance[vertex] = UNREACHABLE<Weight>;
+    }
+    reached.clear();
+    for (const Entry& entry : hub_label) {
+      hub_distance[entry.hub] = UNREACHABLE<Weight>;
+    }
+  }
+
+  template <typename Weight>
+  void HubLabels<Weight>::Labels::Assign(const std::vector<std::vector<Entry>>& labels, Hub padding) {
+    offsets.reserve(labels.size() + 1);
+    offsets.push_back(0);
+    for (const auto& label : labels) {
+      offsets.push_back(offsets.back() + (label.size() + BLOCK - 1) / BLOCK * BLOCK);
+    }
+    hubs.assign(offsets.back(), padding);
+    distances.assign(offsets.back(), UNREACHABLE<Weight>);
+    edges.assign(offsets.back(), ShortestPathTree<Weight>::NO_EDGE);
+    for (size_t vertex = 0; vertex < labels.size(); ++vertex) {
+      size_t index = offsets[vertex];
+      for (const Entry& entry : labels[vertex]) {
+        hubs[index] = entry.hub;
+        distances[index] = entry.distance;
+        edges[index] = entry.edge;
+        ++index;
+      }
+    }
+  }
+
+  template <typename Weight>
+  size_t HubLabels<Weight>::Labels::Find(VertexId vertex, Hub hub) const {
+    return std::lower_bound(hubs.begin() + offsets[vertex], hubs.begin() + offsets[vertex + 1], hub) - hubs.begin();
+  }
+
+  template <typename Weight>
+  std::optional<typename HubLabels<Weight>::Meeting> HubLabels<Weight>::Meet(VertexId from, VertexId to) const {
+    std::optional<Meeting> best;
+    const Hub* out_hubs = out_.hubs.data();
+    const Hub* in_hubs = in_.hubs.data();
+    size_t i = out_.offsets[from], j = in_.offsets[to];
+    const size_t out_end = out_.offsets[from + 1], in_end = in_.offsets[to + 1];
+    auto meet = [&](size_t out_index, size_t in_index) {
+      const Weight distance = out_.distances[out_index] + in_.distances[in_index];
+      if (!best || distance < best->distance) {
+        best = Meeting{distance, out_index, in_index};
+      }
+    };
+
+    // Compares a block of each label all against all, then moves on past
+    // the block with the smaller last hub (or both). Padding sorts last
+    // and never matches, so the blocks need no tail handling.
+    while (i < out_end && j < in_end) {
+#if defined(__SSE2__)
+      const __m128i out_block = _mm_load_si128(reinterpret_cast<const __m128i*>(out_hubs + i));
+      const __m128i in_block = _mm_load_si128(reinterpret_cast<const __m128i*>(in_hubs + j));
+      __m128i equal = _mm_cmpeq_epi32(out_block, in_block);
+      equal = _mm_or_si128(equal, _mm_cmpeq_epi32(out_block, _mm_shuffle_epi32(in_block, _MM_SHUFFLE(0, 3, 2, 1))));
+      equal = _mm_or_si128(equal, _mm_cmpeq_epi32(out_block, _mm_shuffle_epi32(in_block, _MM_SHUFFLE(1, 0, 3, 2))));
+      equal = _mm_or_si128(equal, _mm_cmpeq_epi32(out_block, _mm_shuffle_epi32(in_block, _MM_SHUFFLE(2, 1, 0, 3))));
+      const bool any_equal = _mm_movemask_epi8(equal) != 0;
+#else
+      const bool any_equal = true;
+#endif
+      if (any_equal) {
+        for (size_t a = i; a < i + BLOCK; ++a) {
+          for (size_t b = j; b < j + BLOCK; ++b) {
+            if (out_hubs[a] == in_hubs[b]) {
+              meet(a, b);
+            }
+          }
+        }
+      }
+      const Hub out_last = out_hubs[i + BLOCK - 1], in_last = in_hubs[j + BLOCK - 1];
+      if (out_last <= in_last) {
+        i += BLOCK;
+      }
+      if (in_last <= out_last) {
+        j += BLOCK;
+      }
+    }
+    return best;
+  }
+
+  template <typename Weight>
+  std::optional<Weight> HubLabels<Weight>::FindDistance(VertexId from, VertexId to) const {
+    if (from == to) {
+      return Weight{0};
+    }
+    const auto meeting = Meet(from, to);
+    if (!meeting) {
+      return std::nullopt;
+    }
+    return meeting->distance;
+  }
+
+  template <typename Weight>
+  std::optional<Path<Weight>> HubLabels<Weight>::FindPath(VertexId from, VertexId to) const {
+    if (from == to) {
+      return Path<Weight>{0, {}};
+    }
+    const auto meeting = Meet(from, to);
+    if (!meeting) {
+      return std::nullopt;
+    }
+    Path<Weight> path{meeting->distance, {}};
+    const Hub hub = out_.hubs[meeting->out_index];
+    // from the source up to the hub along out-labels
+    for (size_t index = meeting->out_index; out_.edges[index] != ShortestPathTree<Weight>::NO_EDGE; ) {
+      const EdgeId edge_id = out_.edges[index];
+      path.edges.push_back(edge_id);
+      index = out_.Find(graph_.GetEdge(edge_id).to, hub);
+    }
+    // from the target back to the hub along in-labels
+    const size_t middle = path.edges.size();
+    for (size_t index = meeting->in_index; in_.edges[index] != ShortestPathTree<Weight>::NO_EDGE; ) {
+      const EdgeId edge_id = in_.edges[index];
+      path.edges.push_back(edge_id);
+      index = in_.Find(graph_.GetEdge(edge_id).from, hub);
+    }
+    std::reverse(path.edges.begin() + middle, path.edges.end());
+    return path;
+  }
+
+}
@@ -0,0 +1,75 @@
+#include "input_buffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+InputBuffer InputBuffer::FromFile(const string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("cannot open " + path);
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      close(fd);
+      // the parser makes one forward pass: read ahead aggressively
+      madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+      InputBuffer result;
+      result.mapping_ = mapping;
+      result.size_ = info.st_size;
+      return result;
+    }
+  }
+  InputBuffer result = FromDescriptor(fd);
+  close(fd);
+  return result;
+}
+
+InputBuffer InputBuffer::FromDescriptor(int fd) {
+  InputBuffer result;
+  string& buffer = result.storage_;
+  // a regular file fits at once, with a byte to spare to see its end
+  struct stat info;
+  const bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+  buffer.reserve(regular ? info.st_size + 1 : 1 << 20);
+  for (;;) {
+    if (buffer.size() == buffer.capacity()) {
+      buffer.reserve(2 * buffer.capacity());
+    }
+    const size_t size = buffer.size();
+    buffer.resize(buffer.capacity());
+    const ssize_t count = read(fd, buffer.data() + size, buffer.size() - size);
+    if (count < 0) {
+      buffer.resize(size);
+      if (errno == EINTR) {
+        continue;
+      }
+      throw runtime_error("cannot read input");
+    }
+    buffer.resize(size + count);
+    if (count == 0) {
+      return result;
+    }
+  }
+}
+
+InputBuffer::InputBuffer(InputBuffer&& other) noexcept
+    : mapping_(other.mapping_), size_(other.size_), storage_(move(other.storage_)) {
+  other.mapping_ = nullptr;
+  other.size_ = 0;
+}
+
+InputBuffer::~InputBuffer() {
+  if (mapping_) {
+    munmap(mapping_, size_);
+  }
+}
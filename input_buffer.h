@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Whole input in memory for the parser. Regular files are memory-mapped
+// and read sequentially; pipes and terminals are drained with large read()
+// calls into an owned buffer. Either way no istream is involved.
+class InputBuffer {
+public:
+  static InputBuffer FromFile(const std::string& path);
+  static InputBuffer FromDescriptor(int fd);
+
+  InputBuffer(InputBuffer&& other) noexcept;
+  InputBuffer& operator=(InputBuffer&& other) = delete;
+  ~InputBuffer();
+
+  std::string_view View() const {
+    return mapping_ ? std::string_view(static_cast<const char*>(mapping_), size_) : std::string_view(storage_);
+  }
+
+private:
+  InputBuffer() = default;
+
+  void* mapping_ = nullptr;
+  size_t size_ = 0;
+  std::string storage_;
+};
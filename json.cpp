@@ -1,92 +1,140 @@
 #include "json.h"
-#include <cmath>
+#include <cctype>
+#include <charconv>
+#include <iterator>
+#include <vector>
+#include <stdexcept>
 
 using namespace std;
 
 namespace Json {
 
-  Document::Document(Node root) : root(move(root)) {
+  Document::Document(unique_ptr<pmr::monotonic_buffer_resource> arena, Node* root)
+      : arena(move(arena)), root(root) {
   }
 
   const Node& Document::GetRoot() const {
-    return root;
+    return *root;
   }
 
-  Node LoadNode(istream& input);
+  // Recursive descent over a buffer in memory. Like the stream reader it
+  // replaces, it accepts the subset of JSON the inputs use (no escapes in
+  // strings) and treats the end of the buffer as closing every open value.
+  class Parser {
+  public:
+    Parser(string_view text, pmr::memory_resource* arena)
+        : pos_(text.data()), end_(text.data() + text.size()), arena_(arena) {}
+
+    Node LoadNode() {
+      const char c = Next();
+      if (c == '[') {
+        return LoadArray();
+      } else if (c == '{') {
+        return LoadDict();
+      } else if (c == '"') {
+        return LoadString();
+      } else if (c == 't' || c == 'f') {
+        --pos_;
+        return LoadBool();
+      } else {
+        --pos_;
+        return LoadDouble();
+      }
+    }
 
-  Node LoadArray(istream& input) {
-    vector<Node> result;
+  private:
+    // next non-space character, '\0' at the end of the buffer
+    char Next() {
+      while (pos_ != end_ && isspace(static_cast<unsigned char>(*pos_))) {
+        ++pos_;
+      }
+      return pos_ != end_ ? *pos_++ : '\0';
+    }
 
-    for (char c; input >> c && c != ']'; ) {
-      if (c != ',') {
-        input.putback(c);
+    // Elements are gathered on a scratch stack first, so the array takes
+    // exactly its size from the arena instead of every growth step.
+    Node LoadArray() {
+      const size_t first = scratch_.size();
+      for (char c; (c = Next()) && c != ']'; ) {
+        if (c != ',') {
+          --pos_;
+        }
+        scratch_.push_back(LoadNode());
       }
-      result.push_back(LoadNode(input));
+
+      Array result(arena_);
+      result.reserve(scratch_.size() - first);
+      move(scratch_.begin() + first, scratch_.end(), back_inserter(result));
+      scratch_.resize(first);
+      return Node(move(result));
     }
 
-    return Node(move(result));
-  }
+    Node LoadDouble() {
+      double result;
+      const auto [ptr, error] = from_chars(pos_, end_, result);
+      if (error != errc()) {
+        throw invalid_argument("invalid number in json");
+      }
+      pos_ = ptr;
+      return Node(result);
+    }
 
-  Node LoadDouble(istream& input){
-    double result;
-    input >> result;
-    return Node(result);
-  }
+    Node LoadBool() {
+      const bool result = *pos_ == 't';
+      pos_ += min<ptrdiff_t>(result ? 4 : 5, end_ - pos_);
+      return Node(result);
+    }
 
-  Node LoadBool(istream& input) {
-    bool result = input.peek() == 't';
-    if (result){
-      input.ignore(4);
-    }else{
-      input.ignore(5);
+    pmr::string ReadString() {
+      const char* start = pos_;
+      while (pos_ != end_ && *pos_ != '"') {
+        ++pos_;
+      }
+      pmr::string result(start, pos_, arena_);
+      if (pos_ != end_) {
+        ++pos_;
+      }
+      return result;
     }
 
-    return Node(result);
-  }
+    Node LoadString() {
+      return Node(ReadString());
+    }
 
-  Node LoadString(istream& input) {
-    string line;
-    getline(input, line, '"');
-    return Node(move(line));
-  }
+    Node LoadDict() {
+      Dict result(arena_);
 
-  Node LoadDict(istream& input) {
-    map<string, Node> result;
+      for (char c; (c = Next()) && c != '}'; ) {
+        if (c == ',') {
+          Next();
+        }
 
-    for (char c; input >> c && c != '}'; ) {
-      if (c == ',') {
-        input >> c;
+        pmr::string key = ReadString();
+        Next();
+        result.emplace(move(key), LoadNode());
       }
 
-      string key = LoadString(input).AsString();
-      input >> c;
-      result.emplace(move(key), LoadNode(input));
+      return Node(move(result));
     }
 
-    return Node(move(result));
-  }
-
-  Node LoadNode(istream& input) {
-    char c;
-    input >> c;
-
-    if (c == '[') {
-      return LoadArray(input);
-    } else if (c == '{') {
-      return LoadDict(input);
-    } else if (c == '"') {
-      return LoadString(input);
-    } else if (c == 't' || c == 'f'){
-      input.putback(c);
-      return LoadBool(input);
-    } else {
-      input.putback(c);
-      return LoadDouble(input);
-    }
+    const char* pos_;
+    const char* const end_;
+    pmr::memory_resource* const arena_;
+    vector<Node> scratch_;
+  };
+
+  Document Load(string_view text) {
+    // the tree takes a few times the size of the text
+    auto arena = make_unique<pmr::monotonic_buffer_resource>(max<size_t>(text.size() * 2, 1 << 12));
+    pmr::polymorphic_allocator<Node> allocator(arena.get());
+    Node* root = allocator.allocate(1);
+    allocator.construct(root, Parser(text, arena.get()).LoadNode());
+    return Document(move(arena), root);
   }
 
   Document Load(istream& input) {
-    return Document{LoadNode(input)};
+    const string text(istreambuf_iterator<char>(input), {});
+    return Load(text);
   }
 
 }
@@ -2,31 +2,45 @@
 
 #include <istream>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace Json {
 
-  class Node : std::variant<std::vector<Node>,
-                            std::map<std::string, Node>, 
+  class Node;
+  // containers and strings of a document all live in the document's arena
+  using Array = std::pmr::vector<Node>;
+  using Dict = std::pmr::map<std::pmr::string, Node, std::less<>>;
+
+  class Node : std::variant<Array,
+                            Dict,
                             double,
                             bool,
-                            std::string> {
+                            std::pmr::string> {
   public:
     using variant::variant;
 
     const auto& AsArray() const {
-      return std::get<std::vector<Node>>(*this);
+      return std::get<Array>(*this);
     }
     const auto& AsMap() const {
-      return std::get<std::map<std::string, Node>>(*this);
+      return std::get<Dict>(*this);
+    }
+    bool IsMap() const {
+      return std::holds_alternative<Dict>(*this);
+    }
+    bool IsDouble() const {
+      return std::holds_alternative<double>(*this);
     }
     double AsDouble() const {
       return std::get<double>(*this);
     }
     const auto& AsString() const {
-      return std::get<std::string>(*this);
+      return std::get<std::pmr::string>(*this);
     }
 
     bool AsBool() const {
@@ -34,16 +48,23 @@ namespace Json {
     }
   };
 
+  // Owns a monotonic arena holding every node, key and string of the tree.
+  // The tree is never destroyed node by node: releasing the arena frees it
+  // in a few large deallocations, whatever its size.
   class Document {
   public:
-    explicit Document(Node root);
+    Document(std::unique_ptr<std::pmr::monotonic_buffer_resource> arena, Node* root);
 
     const Node& GetRoot() const;
 
   private:
-    Node root;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    Node* root;
   };
 
+  // parses a document held in memory; the text may be released afterwards
+  Document Load(std::string_view text);
+  // reads the rest of the stream into memory and parses it
   Document Load(std::istream& input);
 
 }
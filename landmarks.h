@@ -0,0 +1,153 @@
+#pragma once
+
+#include "graph.h"
+#include "path_search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Graph {
+
+  // ALT (A*, Landmarks, Triangle inequality) index. For a few landmarks L it
+  // stores d(L, v) and d(v, L) for every vertex v, so that
+  //   d(v, t) >= max(d(v, L) - d(t, L), d(L, t) - d(L, v))
+  // gives an A* potential towards any target t. Landmarks are chosen by
+  // farthest-point selection. Distances are kept as floats, vertex-major,
+  // so one vertex's bounds share a cache line.
+  template <typename Weight>
+  class LandmarkIndex {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    static constexpr float NO_DISTANCE = std::numeric_limits<float>::infinity();
+    // relative rounding error of a stored float, with a margin
+    static constexpr double FLOAT_ERROR = 1e-7;
+
+  public:
+    LandmarkIndex(const Graph& graph, size_t landmark_count);
+
+    class Potential {
+    public:
+      Weight operator()(VertexId vertex) const {
+        const float* from_landmark = index_.from_landmark_.data() + vertex * to_target_.size();
+        const float* to_landmark = index_.to_landmark_.data() + vertex * to_target_.size();
+        double result = 0;
+        for (size_t i = 0; i < to_target_.size(); ++i) {
+          // t reaches L but v does not, or L reaches v but not t:
+          // either way v cannot reach t
+          if ((to_landmark[i] == NO_DISTANCE && to_target_[i] != NO_DISTANCE)
+              || (from_landmark[i] != NO_DISTANCE && from_target_[i] == NO_DISTANCE)) {
+            return ::Graph::UNREACHABLE<Weight>;
+          }
+          // d(v, t) >= d(v, L) - d(t, L)
+          if (to_landmark[i] != NO_DISTANCE && to_target_[i] != NO_DISTANCE) {
+            const double bound = to_landmark[i] - to_target_[i];
+            result = std::max(result, bound - (to_landmark[i] + to_target_[i]) * FLOAT_ERROR);
+          }
+          // d(v, t) >= d(L, t) - d(L, v)
+          if (from_landmark[i] != NO_DISTANCE && from_target_[i] != NO_DISTANCE) {
+            const double bound = from_target_[i] - from_landmark[i];
+            result = std::max(result, bound - (from_landmark[i] + from_target_[i]) * FLOAT_ERROR);
+          }
+        }
+        return static_cast<Weight>(result);
+      }
+
+    private:
+      friend class LandmarkIndex;
+      Potential(const LandmarkIndex& index, VertexId target) : index_(index) {
+        const size_t count = index.landmarks_.size();
+        from_target_.assign(index.from_landmark_.begin() + target * count,
+                            index.from_landmark_.begin() + (target + 1) * count);
+        to_target_.assign(index.to_landmark_.begin() + target * count,
+                          index.to_landmark_.begin() + (target + 1) * count);
+      }
+
+      const LandmarkIndex& index_;
+      std::vector<float> from_target_;  // d(L, t)
+      std::vector<float> to_target_;    // d(t, L)
+    };
+
+    Potential TowardsTarget(VertexId target) const {
+      return Potential(*this, target);
+    }
+
+    const std::vector<VertexId>& GetLandmarks() const {
+      return landmarks_;
+    }
+    size_t GetMemoryUsage() const {
+      return (from_landmark_.capacity() + to_landmark_.capacity()) * sizeof(float);
+    }
+
+  private:
+    std::vector<VertexId> landmarks_;
+    std::vector<float> from_landmark_;
+    std::vector<float> to_landmark_;
+  };
+
+
+  template <typename Weight>
+  LandmarkIndex<Weight>::LandmarkIndex(const Graph& graph, size_t landmark_count) {
+    const size_t vertex_count = graph.GetVertexCount();
+    landmark_count = std::min(landmark_count, vertex_count);
+
+    const PathSearch<Weight> search(graph);
+
+    std::vector<std::vector<float>> from_landmark, to_landmark;
+    auto to_float = [](const ShortestPathTree<Weight>& tree, VertexId vertex) {
+      return tree.Reached(vertex) ? static_cast<float>(tree.distance[vertex]) : NO_DISTANCE;
+    };
+
+    // Distance from the nearest chosen landmark; unreached vertices come first.
+    // Vertices without edges (stops no route serves) are never picked.
+    std::vector<double> nearest(vertex_count, std::numeric_limits<double>::infinity());
+    VertexId start = 0;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      const size_t degree = graph.GetIncidentEdges(vertex).end() - graph.GetIncidentEdges(vertex).begin();
+      if (degree == 0) {
+        nearest[vertex] = -1;
+      } else if (degree > static_cast<size_t>(graph.GetIncidentEdges(start).end() - graph.GetIncidentEdges(start).begin())) {
+        start = vertex;
+      }
+    }
+    // the first landmark is the vertex farthest from the busiest one
+    VertexId next = start;
+    {
+      const auto tree = search.BuildTree(start);
+      double farthest = -1;
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (tree.Reached(vertex) && tree.distance[vertex] > farthest) {
+          farthest = tree.distance[vertex];
+          next = vertex;
+        }
+      }
+    }
+    while (landmarks_.size() < landmark_count) {
+      landmarks_.push_back(next);
+      const auto forward = search.BuildTree(next);
+      const auto backward = search.BuildTree(next, Direction::BACKWARD);
+      from_landmark.emplace_back(vertex_count);
+      to_landmark.emplace_back(vertex_count);
+      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        from_landmark.back()[vertex] = to_float(forward, vertex);
+        to_landmark.back()[vertex] = to_float(backward, vertex);
+        if (forward.Reached(vertex) && nearest[vertex] >= 0) {
+          nearest[vertex] = std::min<double>(nearest[vertex], forward.distance[vertex]);
+        }
+      }
+      nearest[next] = -1;
+      next = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+    }
+
+    from_landmark_.resize(vertex_count * landmarks_.size());
+    to_landmark_.resize(vertex_count * landmarks_.size());
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      for (size_t i = 0; i < landmarks_.size(); ++i) {
+        from_landmark_[vertex * landmarks_.size() + i] = from_landmark[i][vertex];
+        to_landmark_[vertex * landmarks_.size() + i] = to_landmark[i][vertex];
+      }
+    }
+  }
+
+}
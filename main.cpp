@@ -1,32 +1,186 @@
 #include "request.h"
 #include "route_manager.h"
 #include "json.h"
+#include "server.h"
+#include "metrics.h"
+#include "input_buffer.h"
 
-void TestUpdateRequests();
-void TestReadRequests();
-void TestResponses();
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
-int main(){
-    freopen("input/other_input.json", "r", stdin);
-    freopen("output/output5.json", "w", stdout);
-    //TestRunner tr;
-    //RUN_TEST(tr, TestUpdateRequests);
-    //RUN_TEST(tr, TestReadRequests);
-    //RUN_TEST(tr, TestResponses);
-    
-    std::stringstream input_info;
+// value of "--metrics PATH" among the arguments; metrics are dumped there
+// ("-" is stderr) when the build has them compiled in
+std::string MetricsPath(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (!strcmp(argv[i], "--metrics")) {
+            return argv[i + 1];
+        }
+    }
+    return {};
+}
+
+void DumpMetrics(const std::string& path) {
+    if (!path.empty()) {
+#if METRICS_ENABLED
+        Metrics::Dump(path);
+#else
+        std::cerr << "metrics are not compiled in, rebuild with -DTRANSPORT_METRICS\n";
+#endif
+    }
+}
+
+// the file at path in memory, or nothing once the reason it cannot be
+// opened is printed
+std::optional<InputBuffer> OpenInput(const std::string& path) {
+    try {
+        return InputBuffer::FromFile(path);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return std::nullopt;
+    }
+}
+
+// the base requests and routing settings of a document, or nothing when
+// it cannot be opened
+std::optional<std::pair<std::vector<BaseRequest>, RoutingSettings>> LoadBase(const std::string& path) {
+    const std::optional<InputBuffer> input = OpenInput(path);
+    if (!input) {
+        return std::nullopt;
+    }
+    const Json::Document document = Json::Load(input->View());
+    const Json::Node& node = document.GetRoot();
+    return std::pair(ReadRequests<BaseRequests>(node), ReadSettings(node));
+}
+
+// main --serve BASE_JSON [--socket PATH] [--workers N] [--queue N] [--metrics PATH]
+// builds the network from BASE_JSON, then answers newline-delimited stat
+// requests from stdin, or from clients of the Unix socket. SIGHUP reads
+// BASE_JSON again and rebuilds in the background; requests go on being
+// answered from the old network until the new one is swapped in.
+int Serve(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " --serve BASE_JSON [--socket PATH] [--workers N] [--queue N] [--metrics PATH]\n";
+        return 1;
+    }
+    ServerOptions options;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--socket")) {
+            options.socket_path = argv[i + 1];
+        } else if (!strcmp(argv[i], "--workers")) {
+            options.worker_count = std::stoul(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--queue")) {
+            options.queue_capacity = std::stoul(argv[i + 1]);
+        }
+    }
+
+    // a client gone from stdout fails the write instead of killing us
+    signal(SIGPIPE, SIG_IGN);
+
+    // blocked before any thread starts, so that only the reloader takes it
+    sigset_t reload_signals;
+    sigemptyset(&reload_signals);
+    sigaddset(&reload_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &reload_signals, nullptr);
+
+    const std::string base_path = argv[2];
+    const auto base = LoadBase(base_path);
+    if (!base) {
+        return 1;
+    }
+    SnapshotStore store(base->first, base->second);
+    std::atomic<bool> serving = true;
+    std::thread reloader([&] {
+        int signal = 0;
+        while (sigwait(&reload_signals, &signal) == 0 && serving) {
+            try {
+                if (auto base = LoadBase(base_path)) {
+                    store.Rebuild(std::move(base->first), base->second);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "cannot reload " << base_path << ": " << e.what() << "\n";
+            }
+        }
+    });
+
+    RequestServer server(store, options);
+    server.Run();
+    serving = false;
+    pthread_kill(reloader.native_handle(), SIGHUP);
+    reloader.join();
+    DumpMetrics(MetricsPath(argc, argv));
+    return 0;
+}
+
+// stat requests answered at a time with --stream; Route requests from one
+// stop share a search only within a window
+constexpr size_t STREAM_WINDOW = 8192;
+
+// main [INPUT_JSON [OUTPUT_JSON]] [--metrics PATH] [--stream]
+// answers the stat requests of one input document; stdin and stdout stand
+// in for missing paths. --stream writes responses out on a thread of their
+// own as they are ready instead of holding them all until the end.
+int main(int argc, char* argv[]){
+    if (argc > 1 && !strcmp(argv[1], "--serve")) {
+        return Serve(argc, argv);
+    }
+    std::vector<std::string> paths;
+    size_t stream_window = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--metrics")) {
+            ++i;
+        } else if (!strcmp(argv[i], "--stream")) {
+            stream_window = STREAM_WINDOW;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    std::ofstream output_file;
+    if (paths.size() > 1) {
+        output_file.open(paths[1]);
+        if (!output_file) {
+            std::cerr << "cannot open " << paths[1] << "\n";
+            return 1;
+        }
+    }
+    std::ostream& output = paths.size() > 1 ? output_file : std::cout;
 
     RouteManager manager;
-    Json::Document document = Json::Load(std::cin);
-    const Json::Node node = document.GetRoot();
-    const auto routing_settings = ReadSettings(node, input_info);
-    const auto base_requests = ReadRequests<0>(node);
-    ProcessRequests(base_requests, manager);
-
-    manager.RunGraphBuilder(routing_settings);
-    
-    const auto stat_requests = ReadRequests<1>(node);
-    const auto responses = ProcessRequests(stat_requests, manager);
-    PrintResponses(responses, input_info);
+    const std::optional<Json::Document> document = [&paths]() -> std::optional<Json::Document> {
+        METRICS_SCOPE("json_load");
+        const std::optional<InputBuffer> input = paths.size() > 0
+            ? OpenInput(paths[0])
+            : InputBuffer::FromDescriptor(STDIN_FILENO);
+        if (!input) {
+            return std::nullopt;
+        }
+        return Json::Load(input->View());
+    }();
+    if (!document) {
+        return 1;
+    }
+    const Json::Node& node = document->GetRoot();
+    const auto routing_settings = ReadSettings(node);
+    std::vector<BaseRequest> base_requests;
+    {
+        METRICS_SCOPE("base_requests_read");
+        base_requests = ReadRequests<BaseRequests>(node);
+    }
+    {
+        METRICS_SCOPE("base_requests_process");
+        ProcessRequests(base_requests, manager);
+    }
+
+    // stat requests are parsed, and Bus and Stop ones answered, while the
+    // graph and router build
+    BuildAndAnswer(node, routing_settings, manager, output, stream_window);
+    DumpMetrics(MetricsPath(argc, argv));
 }
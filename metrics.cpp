@@ -0,0 +1,145 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+#ifdef TRANSPORT_METRICS
+// every operator new of the process is counted; the array and sized forms
+// fall back to these by default
+static atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+  allocation_count.fetch_add(1, memory_order_relaxed);
+  if (void* result = malloc(size ? size : 1)) {
+    return result;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  free(pointer);
+}
+#endif
+
+namespace Metrics {
+
+  size_t Histogram::BucketOf(uint64_t value) {
+    if (value < SUB_COUNT) {
+      return value;
+    }
+    // keep the SUB_BITS highest bits of the value
+    const int shift = 64 - __builtin_clzll(value) - SUB_BITS;
+    return SUB_COUNT + (shift - 1) * (SUB_COUNT / 2) + ((value >> shift) - SUB_COUNT / 2);
+  }
+
+  uint64_t Histogram::BucketUpperBound(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+      return bucket;
+    }
+    const int shift = (bucket - SUB_COUNT) / (SUB_COUNT / 2) + 1;
+    const uint64_t top = (bucket - SUB_COUNT) % (SUB_COUNT / 2) + SUB_COUNT / 2;
+    return ((top + 1) << shift) - 1;
+  }
+
+  void Histogram::Record(uint64_t value) {
+    buckets_[BucketOf(value)].fetch_add(1, memory_order_relaxed);
+    total_.fetch_add(value, memory_order_relaxed);
+    for (uint64_t max = max_.load(memory_order_relaxed);
+         value > max && !max_.compare_exchange_weak(max, value, memory_order_relaxed); ) {
+    }
+  }
+
+  uint64_t Histogram::Count() const {
+    uint64_t result = 0;
+    for (const auto& bucket : buckets_) {
+      result += bucket.load(memory_order_relaxed);
+    }
+    return result;
+  }
+
+  uint64_t Histogram::Percentile(double quantile) const {
+    const uint64_t count = Count();
+    if (count == 0) {
+      return 0;
+    }
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+      seen += buckets_[bucket].load(memory_order_relaxed);
+      if (seen >= rank) {
+        return min(BucketUpperBound(bucket), Max());
+      }
+    }
+    return Max();
+  }
+
+  Registry& Registry::Instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  Histogram& Registry::GetHistogram(const string& name) {
+    lock_guard<mutex> lock(mutex_);
+    auto& histogram = histograms_[name];
+    if (!histogram) {
+      histogram = make_unique<Histogram>();
+    }
+    return *histogram;
+  }
+
+  Counter& Registry::GetCounter(const string& name) {
+    lock_guard<mutex> lock(mutex_);
+    auto& counter = counters_[name];
+    if (!counter) {
+      counter = make_unique<Counter>();
+    }
+    return *counter;
+  }
+
+  void Registry::DumpJson(ostream& stream) const {
+    lock_guard<mutex> lock(mutex_);
+    stream << fixed << setprecision(3) << "{\n  \"timers\": {";
+    bool first = true;
+    for (const auto& [name, histogram] : histograms_) {
+      stream << (first ? "\n" : ",\n") << "    \"" << name << "\": {"
+             << "\"count\": " << histogram->Count()
+             << ", \"total_ms\": " << histogram->Total() / 1e6
+             << ", \"p50_us\": " << histogram->Percentile(0.5) / 1e3
+             << ", \"p99_us\": " << histogram->Percentile(0.99) / 1e3
+             << ", \"max_us\": " << histogram->Max() / 1e3 << "}";
+      first = false;
+    }
+    stream << "\n  },\n  \"counters\": {";
+    first = true;
+#ifdef TRANSPORT_METRICS
+    stream << "\n    \"allocations\": " << allocation_count.load(memory_order_relaxed);
+    first = false;
+#endif
+    for (const auto& [name, counter] : counters_) {
+      stream << (first ? "\n" : ",\n") << "    \"" << name << "\": " << counter->Get();
+      first = false;
+    }
+    stream << "\n  }\n}\n";
+    stream << defaultfloat;
+  }
+
+  void Dump(const string& path) {
+    if (path == "-") {
+      Registry::Instance().DumpJson(cerr);
+      return;
+    }
+    ofstream output(path);
+    Registry::Instance().DumpJson(output);
+  }
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Pipeline instrumentation: scoped timers feeding latency histograms, and
+// plain counters. Everything is compiled in only with -DTRANSPORT_METRICS;
+// otherwise the METRICS_* macros expand to nothing and cost nothing.
+namespace Metrics {
+
+  // HDR-style histogram of nanosecond values: values below 2^SUB_BITS are
+  // exact, larger ones fall into 2^(SUB_BITS - 1) linear buckets per power
+  // of two, so every recorded value is kept to within ~3%.
+  // Recording takes a few relaxed atomic operations, safe from any thread.
+  class Histogram {
+  public:
+    static constexpr int SUB_BITS = 6;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+
+    void Record(uint64_t value);
+
+    uint64_t Count() const;
+    uint64_t Total() const {
+      return total_.load(std::memory_order_relaxed);
+    }
+    uint64_t Max() const {
+      return max_.load(std::memory_order_relaxed);
+    }
+    // upper bound of the bucket holding the given quantile, 0 when empty
+    uint64_t Percentile(double quantile) const;
+
+  private:
+    static size_t BucketOf(uint64_t value);
+    static uint64_t BucketUpperBound(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT / 2> buckets_{};
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> max_{0};
+  };
+
+  class Counter {
+  public:
+    void Add(uint64_t value) {
+      value_.fetch_add(value, std::memory_order_relaxed);
+    }
+    uint64_t Get() const {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> value_{0};
+  };
+
+  // Named metrics of the process. Lookups take a lock, so call sites keep
+  // the returned reference (the macros below cache it in a static).
+  class Registry {
+  public:
+    static Registry& Instance();
+
+    Histogram& GetHistogram(const std::string& name);
+    Counter& GetCounter(const std::string& name);
+
+    // {"timers": {name: {count, total_ms, p50_us, p99_us, max_us}},
+    //  "counters": {name: value}}; counters include "allocations"
+    void DumpJson(std::ostream& stream) const;
+
+  private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+  };
+
+  // records the lifetime of the scope into a histogram
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+      histogram_.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start_).count());
+    }
+
+  private:
+    Histogram& histogram_;
+    const std::chrono::steady_clock::time_point start_;
+  };
+
+  // writes the JSON dump to stderr for "-", to the named file otherwise
+  void Dump(const std::string& path);
+
+}
+
+#define METRICS_CONCAT_IMPL(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_IMPL(a, b)
+
+#ifdef TRANSPORT_METRICS
+#define METRICS_ENABLED 1
+// times the rest of the enclosing scope under a fixed name
+#define METRICS_SCOPE(name) \
+  static ::Metrics::Histogram& METRICS_CONCAT(metrics_histogram_, __LINE__) = \
+      ::Metrics::Registry::Instance().GetHistogram(name); \
+  ::Metrics::ScopedTimer METRICS_CONCAT(metrics_timer_, __LINE__)(METRICS_CONCAT(metrics_histogram_, __LINE__))
+#define METRICS_COUNT(name, value) \
+  do { \
+    static ::Metrics::Counter& metrics_counter = ::Metrics::Registry::Instance().GetCounter(name); \
+    metrics_counter.Add(value); \
+  } while (false)
+#else
+#define METRICS_ENABLED 0
+#define METRICS_SCOPE(name) do {} while (false)
+#define METRICS_COUNT(name, value) do {} while (false)
+#endif
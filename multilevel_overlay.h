@@ -0,0 +1,323 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "path_search.h"
+#include "search_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+namespace Graph {
+
+  // Customizable route planning over a nested partition of the vertices.
+  // The partition and, per cell and level, the entry vertices (heads of
+  // edges coming in from other cells) and exit vertices (tails of edges
+  // leaving it) depend on the topology alone and are built once. Customize
+  // then computes the weight of a shortcut from every entry to every exit
+  // of each cell from the current edge weights, bottom-up and in parallel
+  // per cell: a cell of one level is searched over the shortcuts of its
+  // subcells and the edges between them. After the edge weights change
+  // (new routing settings), calling Customize again is all it takes.
+  //
+  // A query from s to t searches every vertex v at the highest level whose
+  // cell holds neither s nor t, using the original edges where there is
+  // none: from an entry it takes the shortcuts of its cell, from any vertex
+  // the edges leaving that cell. Shortcuts on the path are unpacked level by
+  // level, repeating the search within their cell.
+  template <typename Weight>
+  class MultilevelOverlay {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  public:
+    // cells[level][vertex], finest level first; each cell lies within one
+    // cell of the next level
+    MultilevelOverlay(const Graph& graph, std::vector<std::vector<uint32_t>> cells);
+
+    // recomputes every shortcut from the current edge weights
+    void Customize(size_t thread_count = 0);
+
+    std::optional<Path<Weight>> FindPath(VertexId from, VertexId to) const;
+
+    size_t GetLevelCount() const {
+      return levels_.size();
+    }
+    size_t GetCellCount(size_t level) const {
+      return levels_[level].entry_offsets.size() - 1;
+    }
+    size_t GetShortcutCount() const {
+      size_t count = 0;
+      for (const Level& level : levels_) {
+        count += level.weights.size();
+      }
+      return count;
+    }
+
+  private:
+    struct Level {
+      std::vector<uint32_t> cell;
+      // entries and exits of every cell, and each vertex's position among them
+      std::vector<size_t> entry_offsets, exit_offsets;
+      std::vector<VertexId> entries, exits;
+      std::vector<uint32_t> entry_index, exit_index;
+      // per cell an entries x exits matrix, row by row from matrix_offsets
+      std::vector<size_t> matrix_offsets;
+      std::vector<Weight> weights;
+
+      size_t ExitCount(uint32_t cell_id) const {
+        return exit_offsets[cell_id + 1] - exit_offsets[cell_id];
+      }
+    };
+
+    struct Workspace {
+      std::vector<Weight> distance;
+      std::vector<VertexId> prev_vertex;
+      std::vector<EdgeId> prev_edge;
+      // 0 for an original edge, else the level of the shortcut plus one
+      std::vector<uint8_t> prev_level;
+      std::vector<uint32_t> stamp;
+      uint32_t generation = 0;
+      SearchQueue<Weight, VertexId> queue;
+
+      void Reset(size_t vertex_count) {
+        if (stamp.size() != vertex_count || ++generation == 0) {
+          distance.assign(vertex_count, Weight{});
+          prev_vertex.assign(vertex_count, 0);
+          prev_edge.assign(vertex_count, 0);
+          prev_level.assign(vertex_count, 0);
+          stamp.assign(vertex_count, 0);
+          generation = 1;
+        }
+        queue.clear();
+      }
+      bool Reached(VertexId vertex) const {
+        return stamp[vertex] == generation;
+      }
+    };
+
+    // the query workspace, and one for unpacking shortcuts
+    static Workspace& GetWorkspace(size_t index) {
+      thread_local Workspace workspaces[2];
+      return workspaces[index];
+    }
+
+    // Dijkstra from `from` until `to` is settled (all reachable vertices if
+    // to is NONE). A vertex at level(v) == 0 takes its original edges, one
+    // at level l the shortcuts and leaving edges of its cell at level l - 1.
+    // Only vertices for which allow(v) holds are reached.
+    template <typename VertexLevel, typename Allow>
+    void Run(Workspace& ws, VertexId from, VertexId to, VertexLevel level, Allow allow) const;
+
+    void CustomizeCell(size_t level, uint32_t cell_id);
+    // the original edges of a shortcut, appended to `edges`
+    void Unpack(size_t level, VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+    // the original edges of the path a search found, shortcuts unpacked
+    void AppendHops(const Workspace& ws, VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+    const Graph& graph_;
+    std::vector<Level> levels_;
+  };
+
+
+  template <typename Weight>
+  MultilevelOverlay<Weight>::MultilevelOverlay(const Graph& graph, std::vector<std::vector<uint32_t>> cells)
+      : graph_(graph), levels_(cells.size()) {
+    const size_t vertex_count = graph.GetVertexCount();
+    for (size_t l = 0; l < levels_.size(); ++l) {
+      Level& level = levels_[l];
+      level.cell = std::move(cells[l]);
+      const size_t cell_count = vertex_count == 0
+          ? 0 : *std::max_element(level.cell.begin(), level.cell.end()) + 1;
+
+      std::vector<char> is_entry(vertex_count, 0), is_exit(vertex_count, 0);
+      for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (level.cell[edge.from] != level.cell[edge.to]) {
+          is_exit[edge.from] = 1;
+          is_entry[edge.to] = 1;
+        }
+      }
+      // vertices grouped by cell, in vertex order
+      auto group = [&](const std::vector<char>& marked, std::vector<size_t>& offsets,
+                       std::vector<VertexId>& members, std::vector<uint32_t>& index) {
+        offsets.assign(cell_count + 1, 0);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+          offsets[level.cell[vertex] + 1] += marked[vertex];
+        }
+        for (size_t cell_id = 0; cell_id < cell_count; ++cell_id) {
+          offsets[cell_id + 1] += offsets[cell_id];
+        }
+        members.resize(offsets.back());
+        index.assign(vertex_count, NONE);
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+          if (marked[vertex]) {
+            const size_t position = next[level.cell[vertex]]++;
+            members[position] = vertex;
+            index[vertex] = static_cast<uint32_t>(position - offsets[level.cell[vertex]]);
+          }
+        }
+      };
+      group(is_entry, level.entry_offsets, level.entries, level.entry_index);
+      group(is_exit, level.exit_offsets, level.exits, level.exit_index);
+
+      level.matrix_offsets.assign(cell_count + 1, 0);
+      for (uint32_t cell_id = 0; cell_id < cell_count; ++cell_id) {
+        const size_t entry_count = level.entry_offsets[cell_id + 1] - level.entry_offsets[cell_id];
+        level.matrix_offsets[cell_id + 1] = level.matrix_offsets[cell_id] + entry_count * level.ExitCount(cell_id);
+      }
+      level.weights.assign(level.matrix_offsets.back(), UNREACHABLE<Weight>);
+    }
+  }
+
+  template <typename Weight>
+  void MultilevelOverlay<Weight>::Customize(size_t thread_count) {
+    for (size_t l = 0; l < levels_.size(); ++l) {
+      ParallelFor(GetCellCount(l), thread_count, [this, l](size_t cell_id) {
+        CustomizeCell(l, static_cast<uint32_t>(cell_id));
+      });
+    }
+  }
+
+  template <typename Weight>
+  void MultilevelOverlay<Weight>::CustomizeCell(size_t l, uint32_t cell_id) {
+    Level& level = levels_[l];
+    const size_t exit_count = level.ExitCount(cell_id);
+    if (exit_count == 0) {
+      return;
+    }
+    Workspace& ws = GetWorkspace(0);
+    // the cell is searched one level down: original edges at the finest level
+    auto sublevel = [l](VertexId) { return l; };
+    auto inside = [&level, cell_id](VertexId vertex) { return level.cell[vertex] == cell_id; };
+    for (size_t i = level.entry_offsets[cell_id]; i < level.entry_offsets[cell_id + 1]; ++i) {
+      Run(ws, level.entries[i], NONE, sublevel, inside);
+      Weight* row = level.weights.data() + level.matrix_offsets[cell_id]
+          + (i - level.entry_offsets[cell_id]) * exit_count;
+      for (size_t j = 0; j < exit_count; ++j) {
+        const VertexId exit = level.exits[level.exit_offsets[cell_id] + j];
+        row[j] = ws.Reached(exit) ? ws.distance[exit] : UNREACHABLE<Weight>;
+      }
+    }
+  }
+
+  template <typename Weight>
+  template <typename VertexLevel, typename Allow>
+  void MultilevelOverlay<Weight>::Run(Workspace& ws, VertexId from, VertexId to, VertexLevel vertex_level,
+                                      Allow allow) const {
+    ws.Reset(graph_.GetVertexCount());
+    ws.stamp[from] = ws.generation;
+    ws.distance[from] = 0;
+    ws.queue.push(0, from);
+
+    auto relax = [&](VertexId vertex, VertexId next, Weight candidate, EdgeId edge_id, uint8_t shortcut_level) {
+      if (!allow(next) || (ws.Reached(next) && ws.distance[next] <= candidate)) {
+        return;
+      }
+      ws.stamp[next] = ws.generation;
+      ws.distance[next] = candidate;
+      ws.prev_vertex[next] = vertex;
+      ws.prev_edge[next] = edge_id;
+      ws.prev_level[next] = shortcut_level;
+      ws.queue.push(candidate, next);
+    };
+
+    while (!ws.queue.empty()) {
+      const auto [distance, vertex] = ws.queue.pop();
+      if (distance > ws.distance[vertex]) {
+        continue;
+      }
+      if (vertex == to) {
+        break;
+      }
+      const size_t l = vertex_level(vertex);
+      if (l == 0) {
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+          const auto& edge = graph_.GetEdge(edge_id);
+          relax(vertex, edge.to, distance + edge.weight, edge_id, 0);
+        }
+        continue;
+      }
+      const Level& level = levels_[l - 1];
+      const uint32_t cell_id = level.cell[vertex];
+      if (const uint32_t entry = level.entry_index[vertex]; entry != NONE) {
+        const size_t exit_count = level.ExitCount(cell_id);
+        const Weight* row = level.weights.data() + level.matrix_offsets[cell_id] + entry * exit_count;
+        for (size_t j = 0; j < exit_count; ++j) {
+          if (row[j] != UNREACHABLE<Weight>) {
+            relax(vertex, level.exits[level.exit_offsets[cell_id] + j], distance + row[j],
+                  ShortestPathTree<Weight>::NO_EDGE, static_cast<uint8_t>(l));
+          }
+        }
+      }
+      if (level.exit_index[vertex] != NONE) {
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+          const auto& edge = graph_.GetEdge(edge_id);
+          if (level.cell[edge.to] != cell_id) {
+            relax(vertex, edge.to, distance + edge.weight, edge_id, 0);
+          }
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  void MultilevelOverlay<Weight>::Unpack(size_t l, VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    // the search customization ran for the shortcut, over the shortcuts of
+    // the subcells, whose hops are unpacked one level down in turn
+    Workspace& ws = GetWorkspace(1);
+    const Level& level = levels_[l];
+    const uint32_t cell_id = level.cell[from];
+    Run(ws, from, to, [l](VertexId) { return l; },
+        [&level, cell_id](VertexId vertex) { return level.cell[vertex] == cell_id; });
+    AppendHops(ws, from, to, edges);
+  }
+
+  template <typename Weight>
+  void MultilevelOverlay<Weight>::AppendHops(const Workspace& ws, VertexId from, VertexId to,
+                                             std::vector<EdgeId>& edges) const {
+    // taken out of the workspace first: unpacking searches in it again
+    std::vector<std::tuple<VertexId, VertexId, EdgeId, uint8_t>> hops;
+    for (VertexId vertex = to; vertex != from; vertex = ws.prev_vertex[vertex]) {
+      hops.emplace_back(ws.prev_vertex[vertex], vertex, ws.prev_edge[vertex], ws.prev_level[vertex]);
+    }
+    for (auto hop = hops.rbegin(); hop != hops.rend(); ++hop) {
+      const auto [hop_from, hop_to, edge_id, shortcut_level] = *hop;
+      if (shortcut_level == 0) {
+        edges.push_back(edge_id);
+      } else {
+        Unpack(shortcut_level - 1, hop_from, hop_to, edges);
+      }
+    }
+  }
+
+  template <typename Weight>
+  std::optional<Path<Weight>> MultilevelOverlay<Weight>::FindPath(VertexId from, VertexId to) const {
+    // the highest level at which a vertex shares its cell with neither end
+    auto query_level = [&](VertexId vertex) {
+      size_t l = 0;
+      while (l < levels_.size() && levels_[l].cell[vertex] != levels_[l].cell[from]
+             && levels_[l].cell[vertex] != levels_[l].cell[to]) {
+        ++l;
+      }
+      return l;
+    };
+    Workspace& ws = GetWorkspace(0);
+    Run(ws, from, to, query_level, [](VertexId) { return true; });
+    if (!ws.Reached(to)) {
+      return std::nullopt;
+    }
+
+    Path<Weight> path{ws.distance[to], {}};
+    AppendHops(ws, from, to, path.edges);
+    return path;
+  }
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Runs func(i) for every i in [0, task_count) on up to thread_count threads.
+// Tasks are handed out one by one, so uneven tasks still balance well.
+// thread_count == 0 means "use every hardware thread".
+template <typename Func>
+void ParallelFor(size_t task_count, size_t thread_count, Func func) {
+  if (thread_count == 0) {
+    thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+  thread_count = std::min(thread_count, task_count);
+  if (thread_count <= 1) {
+    for (size_t i = 0; i < task_count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_task = 0;
+  auto worker = [&] {
+    for (size_t i = next_task++; i < task_count; i = next_task++) {
+      func(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count - 1);
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "graph.h"
+#include "search_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <set>
+#include <vector>
+
+namespace Graph {
+
+  template <typename Weight>
+  struct Path {
+    Weight weight;
+    std::vector<EdgeId> edges;
+  };
+
+  // distances and last edges of shortest paths from one source to every vertex
+  template <typename Weight>
+  constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::max();
+
+  template <typename Weight>
+  struct ShortestPathTree {
+    static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+    std::vector<Weight> distance;
+    std::vector<EdgeId> prev_edge;
+
+    bool Reached(VertexId vertex) const {
+      return distance[vertex] != UNREACHABLE<Weight>;
+    }
+  };
+
+  // an end of a search reached from outside the graph, at a cost
+  template <typename Weight>
+  struct Seed {
+    VertexId vertex;
+    Weight offset;
+  };
+
+  // a path between seeds; its weight includes both offsets
+  template <typename Weight>
+  struct SeededPath {
+    Path<Weight> path;
+    VertexId from;
+    VertexId to;
+  };
+
+  // FORWARD follows edges, BACKWARD walks them in reverse (distances to the source)
+  enum class Direction {
+    FORWARD,
+    BACKWARD
+  };
+
+  struct SearchStats {
+    size_t settled_vertices = 0;
+    size_t relaxed_edges = 0;
+  };
+
+  // Per-query point-to-point search: plain Dijkstra, or A* when a potential
+  // (a lower bound of the remaining distance to the target) is supplied.
+  // The potential only has to be admissible: a vertex is reopened whenever
+  // a shorter path to it shows up, so rounding in the bound is harmless.
+  // A potential of UNREACHABLE marks a vertex that cannot reach the target.
+  // Search arrays live in a per-thread workspace and are reset lazily with
+  // a generation stamp, so a query costs only what it touches. Integer
+  // weights are queued in a radix heap, floating ones in a binary heap.
+  template <typename Weight>
+  class PathSearch {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    explicit PathSearch(const Graph& graph) : graph_(graph) {}
+
+    std::optional<Path<Weight>> FindPath(VertexId from, VertexId to) const {
+      return FindPath(from, to, [](VertexId) { return Weight{0}; });
+    }
+
+    template <typename Potential>
+    std::optional<Path<Weight>> FindPath(VertexId from, VertexId to, Potential potential) const;
+
+    // Dijkstra from every source at its offset, stopped once no target can
+    // still improve: the lightest offset + path + offset over all pairs
+    std::optional<SeededPath<Weight>> FindPath(const std::vector<Seed<Weight>>& sources,
+                                               const std::vector<Seed<Weight>>& targets) const;
+
+    // one Dijkstra from `from` until every target is settled; the path to
+    // each target (in the order given) is the one FindPath(from, target)
+    // finds, since settled vertices keep their last edge
+    std::vector<std::optional<Path<Weight>>> FindPathsTo(VertexId from, const std::vector<VertexId>& targets) const;
+
+    // Dijkstra from both ends at once, meeting in the middle
+    std::optional<Path<Weight>> FindPathBidirectional(VertexId from, VertexId to) const;
+
+    // full Dijkstra from one source; a BACKWARD tree holds distances to it
+    // and, per vertex, the first edge of the path
+    ShortestPathTree<Weight> BuildTree(VertexId from, Direction direction = Direction::FORWARD) const;
+
+    // Up to `count` shortest loopless paths, shortest first (Yen's algorithm).
+    // One backward search from the target per call yields the first path and
+    // the A* potential of every spur search; excluding vertices and edges
+    // only lengthens paths, so the potential stays admissible.
+    std::vector<Path<Weight>> FindPaths(VertexId from, VertexId to, size_t count) const;
+
+    // statistics of the last search run on the calling thread
+    static const SearchStats& LastStats() {
+      return last_stats_;
+    }
+
+  private:
+    struct Workspace {
+      std::vector<Weight> distance;
+      std::vector<Weight> potential;
+      std::vector<EdgeId> prev_edge;
+      std::vector<uint32_t> stamp;
+      uint32_t generation = 0;
+      SearchStats stats;
+      // keyed by distance + potential: (distance, vertex)
+      SearchQueue<Weight, std::pair<Weight, VertexId>> queue;
+
+      void Reset(size_t vertex_count) {
+        if (stamp.size() != vertex_count || ++generation == 0) {
+          distance.assign(vertex_count, Weight{});
+          potential.assign(vertex_count, Weight{});
+          prev_edge.assign(vertex_count, 0);
+          stamp.assign(vertex_count, 0);
+          generation = 1;
+        }
+        stats = {};
+      }
+      bool Reached(VertexId vertex) const {
+        return stamp[vertex] == generation;
+      }
+    };
+
+    // vertices and edges a spur search must avoid, cleared with a stamp too
+    struct Exclusions {
+      std::vector<uint32_t> vertex_stamp;
+      std::vector<uint32_t> edge_stamp;
+      uint32_t generation = 0;
+
+      void Reset(size_t vertex_count, size_t edge_count) {
+        if (vertex_stamp.size() != vertex_count || edge_stamp.size() != edge_count || ++generation == 0) {
+          vertex_stamp.assign(vertex_count, 0);
+          edge_stamp.assign(edge_count, 0);
+          generation = 1;
+        }
+      }
+      void ExcludeVertex(VertexId vertex) {
+        vertex_stamp[vertex] = generation;
+      }
+      void ExcludeEdge(EdgeId edge) {
+        edge_stamp[edge] = generation;
+      }
+      bool HasVertex(VertexId vertex) const {
+        return vertex_stamp[vertex] == generation;
+      }
+      bool HasEdge(EdgeId edge) const {
+        return edge_stamp[edge] == generation;
+      }
+    };
+
+    static Exclusions& GetExclusions() {
+      thread_local Exclusions exclusions;
+      return exclusions;
+    }
+
+    // one workspace per search direction and thread
+    static Workspace& GetWorkspace(Direction direction = Direction::FORWARD) {
+      thread_local Workspace workspaces[2];
+      return workspaces[static_cast<int>(direction)];
+    }
+
+    static std::array<Seed<Weight>, 1> OneSeed(VertexId vertex) {
+      return {{{vertex, Weight{0}}}};
+    }
+
+    // Runs the search from the seeds until the queue is empty or
+    // stop(vertex) returns true for a freshly settled vertex. Edges for
+    // which allow_edge(edge) is false are skipped. Seeds keep NO_EDGE as
+    // their last edge unless a path through the graph beats their offset.
+    template <typename Seeds, typename Potential, typename Stop, typename EdgeFilter>
+    void Run(Workspace& ws, const Seeds& seeds, Direction direction, Potential potential, Stop stop,
+             EdgeFilter allow_edge) const;
+
+    Path<Weight> ExtractPath(const Workspace& ws, VertexId from, VertexId to) const;
+
+    const Graph& graph_;
+    static thread_local SearchStats last_stats_;
+  };
+
+
+  template <typename Weight>
+  thread_local SearchStats PathSearch<Weight>::last_stats_;
+
+  template <typename Weight>
+  template <typename Seeds, typename Potential, typename Stop, typename EdgeFilter>
+  void PathSearch<Weight>::Run(Workspace& ws, const Seeds& seeds, Direction direction, Potential potential,
+                               Stop stop, EdgeFilter allow_edge) const {
+    ws.Reset(graph_.GetVertexCount());
+    auto& queue = ws.queue;
+    queue.clear();
+
+    for (const Seed<Weight>& seed : seeds) {
+      if (!ws.Reached(seed.vertex)) {
+        ws.stamp[seed.vertex] = ws.generation;
+        ws.potential[seed.vertex] = potential(seed.vertex);
+      } else if (ws.distance[seed.vertex] <= seed.offset) {
+        continue;
+      }
+      ws.distance[seed.vertex] = seed.offset;
+      ws.prev_edge[seed.vertex] = ShortestPathTree<Weight>::NO_EDGE;
+      if (ws.potential[seed.vertex] != UNREACHABLE<Weight>) {
+        queue.push(seed.offset + ws.potential[seed.vertex], {seed.offset, seed.vertex});
+      }
+    }
+
+    while (!queue.empty()) {
+      const auto [distance, vertex] = queue.pop().second;
+      if (distance > ws.distance[vertex]) {
+        continue;
+      }
+      ++ws.stats.settled_vertices;
+      if (stop(vertex)) {
+        break;
+      }
+      const bool forward = direction == Direction::FORWARD;
+      for (const EdgeId edge_id : forward ? graph_.GetIncidentEdges(vertex) : graph_.GetIncomingEdges(vertex)) {
+        if (!allow_edge(edge_id)) {
+          continue;
+        }
+        const auto& edge = graph_.GetEdge(edge_id);
+        assert(edge.weight >= 0);
+        ++ws.stats.relaxed_edges;
+        const VertexId next = forward ? edge.to : edge.from;
+        const Weight candidate = distance + edge.weight;
+        if (!ws.Reached(next)) {
+          ws.stamp[next] = ws.generation;
+          ws.potential[next] = potential(next);
+          ws.distance[next] = UNREACHABLE<Weight>;
+        }
+        if (ws.distance[next] <= candidate || ws.potential[next] == UNREACHABLE<Weight>) {
+          continue;
+        }
+        ws.distance[next] = candidate;
+        ws.prev_edge[next] = edge_id;
+        queue.push(candidate + ws.potential[next], {candidate, next});
+      }
+    }
+    last_stats_ = ws.stats;
+  }
+
+  template <typename Weight>
+  Path<Weight> PathSearch<Weight>::ExtractPath(const Workspace& ws, VertexId from, VertexId to) const {
+    Path<Weight> path{ws.distance[to], {}};
+    for (VertexId vertex = to; vertex != from; ) {
+      const EdgeId edge_id = ws.prev_edge[vertex];
+      path.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(std::begin(path.edges), std::end(path.edges));
+    return path;
+  }
+
+  template <typename Weight>
+  template <typename Potential>
+  std::optional<Path<Weight>> PathSearch<Weight>::FindPath(VertexId from, VertexId to, Potential potential) const {
+    Workspace& ws = GetWorkspace();
+    Run(ws, OneSeed(from), Direction::FORWARD, potential, [to](VertexId vertex) { return vertex == to; },
+        [](EdgeId) { return true; });
+
+    if (!ws.Reached(to) || ws.distance[to] == UNREACHABLE<Weight>) {
+      return std::nullopt;
+    }
+    return ExtractPath(ws, from, to);
+  }
+
+  template <typename Weight>
+  std::vector<std::optional<Path<Weight>>> PathSearch<Weight>::FindPathsTo(VertexId from,
+                                                                         const std::vector<VertexId>& targets) const {
+    std::vector<VertexId> pending = targets;
+    std::sort(std::begin(pending), std::end(pending));
+    pending.erase(std::unique(std::begin(pending), std::end(pending)), std::end(pending));
+    size_t remaining = pending.size();
+
+    Workspace& ws = GetWorkspace();
+    Run(ws, OneSeed(from), Direction::FORWARD, [](VertexId) { return Weight{0}; },
+        [&](VertexId vertex) {
+          if (std::binary_search(std::begin(pending), std::end(pending), vertex)) {
+            --remaining;
+          }
+          return remaining == 0;
+        },
+        [](EdgeId) { return true; });
+
+    std::vector<std::optional<Path<Weight>>> paths;
+    paths.reserve(targets.size());
+    for (const VertexId to : targets) {
+      if (!ws.Reached(to) || ws.distance[to] == UNREACHABLE<Weight>) {
+        paths.emplace_back();
+      } else {
+        paths.push_back(ExtractPath(ws, from, to));
+      }
+    }
+    return paths;
+  }
+
+  template <typename Weight>
+  std::optional<SeededPath<Weight>> PathSearch<Weight>::FindPath(const std::vector<Seed<Weight>>& sources,
+                                                                 const std::vector<Seed<Weight>>& targets) const {
+    Workspace& ws = GetWorkspace();
+    Weight best = UNREACHABLE<Weight>;
+    VertexId best_target = 0;
+    // vertices settle in distance order, so the first one at or past the
+    // best total ends the search
+    Run(ws, sources, Direction::FORWARD, [](VertexId) { return Weight{0}; },
+        [&](VertexId vertex) {
+          const Weight distance = ws.distance[vertex];
+          if (distance >= best) {
+            return true;
+          }
+          for (const Seed<Weight>& target : targets) {
+            if (target.vertex == vertex && distance + target.offset < best) {
+              best = distance + target.offset;
+              best_target = vertex;
+            }
+          }
+          return false;
+        },
+        [](EdgeId) { return true; });
+
+    if (best == UNREACHABLE<Weight>) {
+      return std::nullopt;
+    }
+    SeededPath<Weight> result{{best, {}}, best_target, best_target};
+    while (ws.prev_edge[result.from] != ShortestPathTree<Weight>::NO_EDGE) {
+      const EdgeId edge_id = ws.prev_edge[result.from];
+      result.path.edges.push_back(edge_id);
+      result.from = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(std::begin(result.path.edges), std::end(result.path.edges));
+    return result;
+  }
+
+  template <typename Weight>
+  std::optional<Path<Weight>> PathSearch<Weight>::FindPathBidirectional(VertexId from, VertexId to) const {
+    Workspace& fw = GetWorkspace(Direction::FORWARD);
+    Workspace& bw = GetWorkspace(Direction::BACKWARD);
+    fw.Reset(graph_.GetVertexCount());
+    bw.Reset(graph_.GetVertexCount());
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+    Queue queues[2];
+    Workspace* spaces[2] = {&fw, &bw};
+    for (int side = 0; side < 2; ++side) {
+      const VertexId start = side == 0 ? from : to;
+      spaces[side]->stamp[start] = spaces[side]->generation;
+      spaces[side]->distance[start] = 0;
+      queues[side].push({0, start});
+    }
+
+    // best known path length and the vertex where its two halves meet
+    Weight best = UNREACHABLE<Weight>;
+    VertexId meeting = from;
+    if (from == to) {
+      best = 0;
+    }
+
+    auto top = [&](int side) {
+      return queues[side].empty() ? UNREACHABLE<Weight> : queues[side].top().first;
+    };
+    while (!queues[0].empty() || !queues[1].empty()) {
+      // a shorter path would need both frontiers to still be below it
+      if (top(0) == UNREACHABLE<Weight> || top(1) == UNREACHABLE<Weight> || top(0) + top(1) >= best) {
+        break;
+      }
+      const int side = top(0) <= top(1) ? 0 : 1;
+      Workspace& ws = *spaces[side];
+      const Workspace& other = *spaces[1 - side];
+      const auto [distance, vertex] = queues[side].top();
+      queues[side].pop();
+      if (distance > ws.distance[vertex]) {
+        continue;
+      }
+      ++ws.stats.settled_vertices;
+
+      for (const EdgeId edge_id : side == 0 ? graph_.GetIncidentEdges(vertex) : graph_.GetIncomingEdges(vertex)) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        assert(edge.weight >= 0);
+        ++ws.stats.relaxed_edges;
+        const VertexId next = side == 0 ? edge.to : edge.from;
+        const Weight candidate = distance + edge.weight;
+        if (ws.Reached(next) && ws.distance[next] <= candidate) {
+          continue;
+        }
+        ws.stamp[next] = ws.generation;
+        ws.distance[next] = candidate;
+        ws.prev_edge[next] = edge_id;
+        queues[side].push({candidate, next});
+        if (other.Reached(next) && candidate + other.distance[next] < best) {
+          best = candidate + other.distance[next];
+          meeting = next;
+        }
+      }
+    }
+
+    last_stats_ = {fw.stats.settled_vertices + bw.stats.settled_vertices,
+                   fw.stats.relaxed_edges + bw.stats.relaxed_edges};
+    if (best == UNREACHABLE<Weight>) {
+      return std::nullopt;
+    }
+    // forward half from the source, then the backward half towards the target
+    Path<Weight> path = ExtractPath(fw, from, meeting);
+    for (VertexId vertex = meeting; vertex != to; ) {
+      const EdgeId edge_id = bw.prev_edge[vertex];
+      path.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).to;
+    }
+    path.weight = best;
+    return path;
+  }
+
+  template <typename Weight>
+  ShortestPathTree<Weight> PathSearch<Weight>::BuildTree(VertexId from, Direction direction) const {
+    Workspace& ws = GetWorkspace();
+    Run(ws, OneSeed(from), direction, [](VertexId) { return Weight{0}; }, [](VertexId) { return false; },
+        [](EdgeId) { return true; });
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    ShortestPathTree<Weight> tree{
+        std::vector<Weight>(vertex_count, UNREACHABLE<Weight>),
+        std::vector<EdgeId>(vertex_count, ShortestPathTree<Weight>::NO_EDGE)
+    };
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      if (ws.Reached(vertex) && ws.distance[vertex] != UNREACHABLE<Weight>) {
+        tree.distance[vertex] = ws.distance[vertex];
+        tree.prev_edge[vertex] = vertex == from ? ShortestPathTree<Weight>::NO_EDGE : ws.prev_edge[vertex];
+      }
+    }
+    return tree;
+  }
+
+  template <typename Weight>
+  std::vector<Path<Weight>> PathSearch<Weight>::FindPaths(VertexId from, VertexId to, size_t count) const {
+    std::vector<Path<Weight>> paths;
+    if (count == 0) {
+      return paths;
+    }
+    // backward search from the target until it settles the source: exact
+    // distances to the target inside that ball, and its radius as a lower
+    // bound outside of it
+    Workspace& to_target = GetWorkspace(Direction::BACKWARD);
+    Run(to_target, OneSeed(to), Direction::BACKWARD, [](VertexId) { return Weight{0}; },
+        [from](VertexId vertex) { return vertex == from; }, [](EdgeId) { return true; });
+    SearchStats stats = to_target.stats;
+    if (!to_target.Reached(from) || to_target.distance[from] == UNREACHABLE<Weight>) {
+      return paths;
+    }
+    const Weight radius = to_target.distance[from];
+    auto distance_to_target = [&to_target, radius](VertexId vertex) {
+      return to_target.Reached(vertex) ? std::min(to_target.distance[vertex], radius) : radius;
+    };
+
+    Path<Weight> best{radius, {}};
+    for (VertexId vertex = from; vertex != to; ) {
+      const EdgeId edge_id = to_target.prev_edge[vertex];
+      best.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).to;
+    }
+    paths.push_back(std::move(best));
+
+    Workspace& ws = GetWorkspace();
+    Exclusions& excluded = GetExclusions();
+    // the set orders candidates by weight and drops duplicates
+    std::set<std::pair<Weight, std::vector<EdgeId>>> candidates;
+    std::vector<VertexId> vertices;
+    while (paths.size() < count) {
+      const Path<Weight>& last = paths.back();
+      vertices.assign(1, from);
+      for (const EdgeId edge_id : last.edges) {
+        vertices.push_back(graph_.GetEdge(edge_id).to);
+      }
+      // deviate from the last path at every vertex in turn: keep its first
+      // `spur` edges, leave the spur vertex by an edge no accepted path with
+      // the same root took, and never return to the root
+      Weight root_weight = 0;
+      for (size_t spur = 0; spur < last.edges.size(); ++spur) {
+        excluded.Reset(graph_.GetVertexCount(), graph_.GetEdgeCount());
+        for (size_t i = 0; i < spur; ++i) {
+          excluded.ExcludeVertex(vertices[i]);
+        }
+        for (const auto& path : paths) {
+          if (path.edges.size() > spur
+              && std::equal(std::begin(last.edges), std::begin(last.edges) + spur, std::begin(path.edges))) {
+            excluded.ExcludeEdge(path.edges[spur]);
+          }
+        }
+        Run(ws, OneSeed(vertices[spur]), Direction::FORWARD,
+            [&](VertexId vertex) {
+              return excluded.HasVertex(vertex) ? UNREACHABLE<Weight> : distance_to_target(vertex);
+            },
+            [to](VertexId vertex) { return vertex == to; },
+            [&excluded](EdgeId edge_id) { return !excluded.HasEdge(edge_id); });
+        stats.settled_vertices += ws.stats.settled_vertices;
+        stats.relaxed_edges += ws.stats.relaxed_edges;
+
+        if (ws.Reached(to) && ws.distance[to] != UNREACHABLE<Weight>) {
+          const Path<Weight> spur_path = ExtractPath(ws, vertices[spur], to);
+          std::vector<EdgeId> edges(std::begin(last.edges), std::begin(last.edges) + spur);
+          edges.insert(std::end(edges), std::begin(spur_path.edges), std::end(spur_path.edges));
+          candidates.emplace(root_weight + spur_path.weight, std::move(edges));
+        }
+        root_weight += graph_.GetEdge(last.edges[spur]).weight;
+      }
+      if (candidates.empty()) {
+        break;
+      }
+      auto candidate = candidates.extract(std::begin(candidates));
+      paths.push_back({candidate.value().first, std::move(candidate.value().second)});
+    }
+    last_stats_ = stats;
+    return paths;
+  }
+
+}
@@ -0,0 +1,164 @@
+#include "raptor.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+using namespace std;
+
+static constexpr uint32_t NOT_QUEUED = numeric_limits<uint32_t>::max();
+static constexpr double NOT_REACHED = numeric_limits<double>::infinity();
+
+Raptor::Raptor(size_t stop_count, vector<Pattern> patterns, double wait_time, double velocity)
+        : stop_count_(stop_count), wait_time_(wait_time), velocity_(velocity) {
+    pattern_routes_.reserve(patterns.size());
+    pattern_offsets_.reserve(patterns.size() + 1);
+    pattern_offsets_.push_back(0);
+    vector<size_t> stop_degrees(stop_count + 1, 0);
+    for (const Pattern& pattern : patterns) {
+        pattern_routes_.push_back(pattern.route);
+        pattern_stops_.insert(end(pattern_stops_), begin(pattern.stops), end(pattern.stops));
+        pattern_distances_.insert(end(pattern_distances_), begin(pattern.distances), end(pattern.distances));
+        pattern_offsets_.push_back(pattern_stops_.size());
+        for (const uint32_t stop : pattern.stops) {
+            ++stop_degrees[stop + 1];
+        }
+    }
+
+    stop_offsets_.resize(stop_count + 1);
+    partial_sum(begin(stop_degrees), end(stop_degrees), begin(stop_offsets_));
+    stop_patterns_.resize(stop_offsets_.back());
+    vector<size_t> filled(begin(stop_offsets_), end(stop_offsets_) - 1);
+    for (uint32_t pattern = 0; pattern < GetPatternCount(); ++pattern) {
+        for (size_t i = pattern_offsets_[pattern]; i < pattern_offsets_[pattern + 1]; ++i) {
+            stop_patterns_[filled[pattern_stops_[i]]++] = {pattern, static_cast<uint32_t>(i - pattern_offsets_[pattern])};
+        }
+    }
+}
+
+vector<Raptor::Journey> Raptor::FindJourneys(uint32_t from, uint32_t to) const {
+    if (from == to) {
+        return {Journey{{}, 0}};
+    }
+    Workspace& ws = GetWorkspace();
+    if (ws.best.size() != stop_count_ || ws.queued_from.size() != GetPatternCount() || ++ws.generation == 0) {
+        ws.best.assign(stop_count_, NOT_REACHED);
+        ws.boarding.assign(stop_count_, NOT_REACHED);
+        ws.reached.assign(stop_count_, 0);
+        ws.stamp.assign(ws.stamp.size(), 0);
+        ws.queued_from.assign(GetPatternCount(), NOT_QUEUED);
+        ws.generation = 1;
+    }
+    auto has_label = [&ws, this](size_t round, uint32_t stop) {
+        return ws.stamp[round * stop_count_ + stop] == ws.generation;
+    };
+    auto best = [&ws](uint32_t stop) {
+        return ws.reached[stop] == ws.generation ? ws.best[stop] : NOT_REACHED;
+    };
+    auto reach = [&ws, this](size_t round, uint32_t stop, const Label& label) {
+        if (ws.reached[stop] != ws.generation) {
+            ws.reached[stop] = ws.generation;
+            ws.boarding[stop] = NOT_REACHED;
+        }
+        ws.best[stop] = label.arrival;
+        ws.labels[round * stop_count_ + stop] = label;
+        ws.stamp[round * stop_count_ + stop] = ws.generation;
+    };
+
+    ws.labels.resize(max(ws.labels.size(), stop_count_));
+    ws.stamp.resize(max(ws.stamp.size(), stop_count_), 0);
+    reach(0, from, {0, 0, 0, 0});
+    ws.boarding[from] = 0;
+    ws.marked.assign(1, from);
+
+    vector<size_t> target_rounds;
+    for (size_t round = 1; !ws.marked.empty(); ++round) {
+        ws.labels.resize(max(ws.labels.size(), (round + 1) * stop_count_));
+        ws.stamp.resize(max(ws.stamp.size(), (round + 1) * stop_count_), 0);
+
+        // every pattern through a stop improved in the last round, scanned
+        // from the first such stop on
+        ws.queued.clear();
+        for (const uint32_t stop : ws.marked) {
+            for (size_t i = stop_offsets_[stop]; i < stop_offsets_[stop + 1]; ++i) {
+                const auto [pattern, position] = stop_patterns_[i];
+                if (ws.queued_from[pattern] == NOT_QUEUED) {
+                    ws.queued.push_back(pattern);
+                    ws.queued_from[pattern] = position;
+                } else {
+                    ws.queued_from[pattern] = min(ws.queued_from[pattern], position);
+                }
+            }
+        }
+
+        ws.next_marked.clear();
+        for (const uint32_t pattern : ws.queued) {
+            const uint32_t first = ws.queued_from[pattern];
+            ws.queued_from[pattern] = NOT_QUEUED;
+            const uint32_t* stops = pattern_stops_.data() + pattern_offsets_[pattern];
+            const uint32_t length = pattern_offsets_[pattern + 1] - pattern_offsets_[pattern];
+
+            bool boarded = false;
+            uint32_t board_position = 0;
+            double board_time = 0;
+            for (uint32_t position = first; position < length; ++position) {
+                const uint32_t stop = stops[position];
+                double arrival = NOT_REACHED;
+                if (boarded) {
+                    arrival = board_time + RideTime(pattern, board_position, position);
+                    if (arrival < best(stop) && arrival < best(to)) {
+                        if (!has_label(round, stop)) {
+                            ws.next_marked.push_back(stop);
+                        }
+                        reach(round, stop, {arrival, pattern, board_position, position});
+                    }
+                }
+                // board here when that beats staying on the bus
+                if (ws.reached[stop] == ws.generation && ws.boarding[stop] != NOT_REACHED
+                        && ws.boarding[stop] + wait_time_ < arrival) {
+                    boarded = true;
+                    board_position = position;
+                    board_time = ws.boarding[stop] + wait_time_;
+                }
+            }
+        }
+
+        // the next round boards at what this one reached
+        for (const uint32_t stop : ws.next_marked) {
+            ws.boarding[stop] = ws.best[stop];
+        }
+        if (has_label(round, to)) {
+            target_rounds.push_back(round);
+        }
+        swap(ws.marked, ws.next_marked);
+    }
+
+    vector<Journey> journeys;
+    journeys.reserve(target_rounds.size());
+    for (const size_t round : target_rounds) {
+        journeys.push_back(ExtractJourney(ws, from, to, round));
+    }
+    return journeys;
+}
+
+Raptor::Journey Raptor::ExtractJourney(const Workspace& ws, uint32_t from, uint32_t to, size_t round) const {
+    Journey journey{{}, 0};
+    for (uint32_t stop = to; stop != from; --round) {
+        // the boarding time of a round is the latest label of an earlier one
+        while (ws.stamp[round * stop_count_ + stop] != ws.generation) {
+            --round;
+        }
+        const Label& label = ws.labels[round * stop_count_ + stop];
+        const uint32_t board_stop = pattern_stops_[pattern_offsets_[label.pattern] + label.board_position];
+        journey.legs.push_back({pattern_routes_[label.pattern], board_stop, stop,
+                                static_cast<int>(label.alight_position - label.board_position),
+                                wait_time_, RideTime(label.pattern, label.board_position, label.alight_position)});
+        stop = board_stop;
+    }
+    reverse(begin(journey.legs), end(journey.legs));
+    for (const Leg& leg : journey.legs) {
+        journey.total_time += leg.wait_time;
+        journey.total_time += leg.ride_time;
+    }
+    return journey;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Round-based public transit search (RAPTOR) over the stop sequences of the
+// routes, for the frequency model of the graph: every boarding costs the
+// same wait and a ride takes its road distance over the bus velocity.
+// Round k finds the earliest arrival at every stop with exactly k rides by
+// scanning each route touched in round k - 1 once, front to back, so the
+// quadratic set of ride edges is never built. Arrivals that do not beat the
+// best one at the target are pruned, which leaves at the target exactly the
+// Pareto set of (arrival time, transfers).
+class Raptor {
+public:
+    // one direction of a route: the stops in travel order and the road
+    // distance from the first stop to each of them
+    struct Pattern {
+        std::string_view route;
+        std::vector<uint32_t> stops;
+        std::vector<int> distances;
+    };
+
+    struct Leg {
+        std::string_view route;
+        uint32_t from_stop;
+        uint32_t to_stop;
+        int span_count;
+        double wait_time;
+        double ride_time;
+    };
+
+    struct Journey {
+        std::vector<Leg> legs;
+        double total_time;
+    };
+
+    // rides only go forward along a pattern
+    Raptor(size_t stop_count, std::vector<Pattern> patterns, double wait_time, double velocity);
+
+    // the Pareto-optimal journeys, fewest rides (and latest arrival) first;
+    // empty when the target cannot be reached
+    std::vector<Journey> FindJourneys(uint32_t from, uint32_t to) const;
+
+    size_t GetPatternCount() const {
+        return pattern_offsets_.size() - 1;
+    }
+
+private:
+    // the pattern (and its position) by which a stop was reached in a round
+    struct Label {
+        double arrival;
+        uint32_t pattern;
+        uint32_t board_position;
+        uint32_t alight_position;
+    };
+
+    struct Workspace {
+        // earliest arrival with any number of rides, and as of the
+        // beginning of the current round; valid where reached is stamped
+        std::vector<double> best;
+        std::vector<double> boarding;
+        std::vector<uint32_t> reached;
+        // labels[round * stop_count + stop], valid when the stamp matches
+        std::vector<Label> labels;
+        std::vector<uint32_t> stamp;
+        uint32_t generation = 0;
+        // first position at which each queued pattern is to be scanned
+        std::vector<uint32_t> queued_from;
+        std::vector<uint32_t> queued;
+        std::vector<uint32_t> marked;
+        std::vector<uint32_t> next_marked;
+    };
+    static Workspace& GetWorkspace() {
+        thread_local Workspace workspace;
+        return workspace;
+    }
+
+    double RideTime(uint32_t pattern, uint32_t from_position, uint32_t to_position) const {
+        const size_t offset = pattern_offsets_[pattern];
+        return (pattern_distances_[offset + to_position] - pattern_distances_[offset + from_position]) / velocity_;
+    }
+
+    Journey ExtractJourney(const Workspace& ws, uint32_t from, uint32_t to, size_t round) const;
+
+    const size_t stop_count_;
+    const double wait_time_;
+    const double velocity_;
+
+    // patterns laid out back to back: stops and cumulative distances
+    std::vector<std::string_view> pattern_routes_;
+    std::vector<size_t> pattern_offsets_;
+    std::vector<uint32_t> pattern_stops_;
+    std::vector<int> pattern_distances_;
+    // for every stop, the patterns serving it and the position of the stop
+    std::vector<size_t> stop_offsets_;
+    std::vector<std::pair<uint32_t, uint32_t>> stop_patterns_;
+};
@@ -1,6 +1,11 @@
 #include "request.h"
+#include "metrics.h"
+#include "response_stream.h"
+#include <future>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <unordered_map>
 
 using namespace std;
 
@@ -36,24 +41,6 @@ int ConvertToInt(string_view str) {
   return result;
 }
 
-std::optional<Request::Type> ConvertBaseRequestType(std::string_view type_str) {
-  if (const auto it = STR_TO_UPDATE_REQUEST_TYPE.find(type_str);
-      it != STR_TO_UPDATE_REQUEST_TYPE.end()) {
-    return it->second;
-  } else {
-    return std::nullopt;
-  }
-}
-
-std::optional<Request::Type> ConvertStatRequestType(std::string_view type_str) {
-  if (const auto it = STR_TO_READ_REQUEST_TYPE.find(type_str);
-      it != STR_TO_READ_REQUEST_TYPE.end()) {
-    return it->second;
-  } else {
-    return std::nullopt;
-  }
-}
-
 double ConvertToDouble(string_view str){
     size_t pos;
     const double result = stod(string(str), &pos);
@@ -65,15 +52,19 @@ double ConvertToDouble(string_view str){
     return result;
 }
 
+Coordinate ParseCoordinate(const RequestMap& map) {
+  return {map.at("latitude").AsDouble(), map.at("longitude").AsDouble()};
+}
+
 void AddStopRequest::ParseFrom(const RequestMap& map) {
   stop = map.at("name").AsString();
   lat = map.at("latitude").AsDouble();
   lon = map.at("longitude").AsDouble();
   
   const RequestMap& dist_map = map.at("road_distances").AsMap();
-  for (const auto [other_stop, dist_node] : dist_map){
+  for (const auto& [other_stop, dist_node] : dist_map){
       int distance = static_cast<int>(dist_node.AsDouble());
-      other_stops.push_back(make_pair(distance, other_stop));
+      other_stops.emplace_back(distance, other_stop);
   }
 }
 
@@ -89,92 +80,223 @@ void AddRouteRequest::ParseFrom(const RequestMap& map) {
   const RequestArray& route_stops = map.at("stops").AsArray();
 
   for (const auto& stop_node : route_stops )
-      stops.push_back(stop_node.AsString());
+      stops.emplace_back(stop_node.AsString());
+
+  if (const auto it = map.find("departures"); it != map.end()) {
+    for (const auto& departure_node : it->second.AsArray())
+        departures.push_back(departure_node.AsDouble());
+  }
 }
 
 void AddRouteRequest::Process(RouteManager& manager) const {
-  manager.AddRoute(route, stops, is_roundtrip);
-}
-
-RequestHolder Request::Create(Request::Type type) {
-  switch (type) {
-    case Request::Type::ADD_STOP:
-      return make_unique<AddStopRequest>();
-    case Request::Type::ADD_ROUTE:
-      return make_unique<AddRouteRequest>();
-    case Request::Type::READ_ROUTE:
-      return make_unique<ReadRouteRequest>();
-    case Request::Type::READ_STOP:
-      return make_unique<ReadStopRequest>();
-    case Request::Type::READ_SEARCH_ROUTE:
-      return make_unique<ReadRouteSearchRequest>();
-    default:
-      return nullptr;
+  manager.AddRoute(route, stops, is_roundtrip, departures);
+}
+
+void ProcessRequests(const vector<BaseRequest>& requests, RouteManager& manager) {
+  for (const auto& request : requests) {
+    visit([&manager](const auto& base_request) { base_request.Process(manager); }, request);
   }
 }
 
-vector<ResponseHolder> ProcessRequests(const vector<RequestHolder>& requests, 
-  RouteManager& manager) {
-  vector<ResponseHolder> responses;
-  responses.reserve(requests.size());
+Response ProcessRequest(const StatRequest& request, const RouteManager& manager) {
+  return visit([&manager](const auto& stat_request) -> Response {
+    METRICS_SCOPE("request_" + string(decay_t<decltype(stat_request)>::NAME));
+    return stat_request.Process(manager);
+  }, request);
+}
 
-  for (const auto& request_holder : requests) {
-    if (request_holder->type == Request::Type::READ_ROUTE) {
-      const auto& request = static_cast<const ReadRouteRequest&>(*request_holder);
-      ResponseHolder rh = request.Process(manager);
-      responses.push_back(move(rh));
+vector<Response> ProcessRequests(const vector<StatRequest>& requests, const RouteManager& manager) {
+  unordered_map<string_view, vector<size_t>> route_groups;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto* route = get_if<ReadRouteSearchRequest>(&requests[i]);
+    if (route && route->IsPlain()) {
+      route_groups[route->from].push_back(i);
     }
-    else if (request_holder->type == Request::Type::READ_STOP) {
-      const auto& request = static_cast<const ReadStopRequest&>(*request_holder);
-      responses.push_back(request.Process(manager));
-    } 
-    else if (request_holder->type == Request::Type::READ_SEARCH_ROUTE) {
-      const auto& request = static_cast<const ReadRouteSearchRequest&>(*request_holder);
-      responses.push_back(request.Process(manager));
+  }
+
+  vector<Response> responses(requests.size());
+  vector<bool> answered(requests.size(), false);
+  vector<pair<string, int>> targets;
+  for (const auto& [from, indices] : route_groups) {
+    if (indices.size() < 2) {
+      continue;
     }
-    else {
-      const auto& request = static_cast<const BaseRequest&>(*request_holder);
-      request.Process(manager);
+    METRICS_SCOPE("route_batch");
+    METRICS_COUNT("route_batch_size", indices.size());
+    targets.clear();
+    for (const size_t i : indices) {
+      const auto& route = get<ReadRouteSearchRequest>(requests[i]);
+      targets.emplace_back(route.to, route.request_id);
+    }
+    auto batch = manager.ReadRouteSearches(string(from), targets);
+    for (size_t k = 0; k < indices.size(); ++k) {
+      responses[indices[k]] = move(batch[k]);
+      answered[indices[k]] = true;
+    }
+  }
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (!answered[i]) {
+      responses[i] = ProcessRequest(requests[i], manager);
     }
   }
   return responses;
 }
 
-void PrintResponses(const vector<ResponseHolder>& responses, stringstream& input_info, ostream& stream) {
+void PrintResponse(const Response& response, ostream& stream) {
+  stream << "\t{\n";
+  visit([&stream](const auto& alternative) { stream << alternative << endl; }, response);
+  stream << "\t}";
+}
+
+void PrintResponses(const vector<Response>& responses, ostream& stream) {
+  METRICS_SCOPE("print_responses");
   stream << "[\n";
   size_t i = 0;
-  for (const ResponseHolder& response_holder : responses) {
-    stream << "\t{\n";
-    if (response_holder->type == Response::Type::SEND_ROUTE) {
-      const auto& response = static_cast<const ReadRouteResponse&>(*response_holder);
-      stream << response << endl;
+  for (const Response& response : responses) {
+    PrintResponse(response, stream);
+    if (i < responses.size() - 1) stream << ",\n";
+    else stream << "\n";
+    ++i;
+  }
+  stream << "]"; 
+}
+
+bool NeedsRouter(const StatRequest& request) {
+  return !holds_alternative<ReadRouteRequest>(request) && !holds_alternative<ReadStopRequest>(request);
+}
+
+void BuildAndAnswer(const Json::Node& document, const RoutingSettings& settings,
+    RouteManager& manager, ostream& stream, size_t stream_window) {
+  // the stat requests, and the printed responses of those the router is
+  // not needed for; ReadRoute and ReadStop leave the graph alone
+  struct Early {
+    vector<StatRequest> requests;
+    vector<string> printed;
+  };
+  auto early = async(launch::async, [&document, &manager] {
+    Early result;
+    {
+      METRICS_SCOPE("stat_requests_read");
+      result.requests = ReadRequests<StatRequests>(document);
     }
-    else if (response_holder->type == Response::Type::SEND_STOP) {
-      const auto& response = static_cast<const ReadStopResponse&>(*response_holder);
-      stream << response << endl;
+    METRICS_SCOPE("stat_requests_early");
+    result.printed.resize(result.requests.size());
+    ostringstream printed;
+    for (size_t i = 0; i < result.requests.size(); ++i) {
+      if (!NeedsRouter(result.requests[i])) {
+        printed.str({});
+        PrintResponse(ProcessRequest(result.requests[i], manager), printed);
+        result.printed[i] = printed.str();
+      }
     }
-    else if (response_holder->type == Response::Type::SEND_ROUTE_SEARCH) {
-      const auto& response = static_cast<const ReadRouteSearchResponse&> (*response_holder);
+    return result;
+  });
+  manager.RunGraphBuilder(settings);
+  Early answered = early.get();
 
-      if (response.total_time == 1662.7845714285713 || response.total_time == 1115.6371428571429) {
-        std::cerr << input_info.str();
+  const size_t count = answered.requests.size();
+  if (stream_window > 0) {
+    ResponseStream output(stream);
+    vector<StatRequest> window;
+    size_t next = 0;
+    // prints every request before `end`, answering those in the window
+    auto flush = [&](size_t end) {
+      vector<Response> responses;
+      {
+        METRICS_SCOPE("stat_requests_process");
+        responses = ProcessRequests(window, manager);
+      }
+      window.clear();
+      auto response = responses.begin();
+      // Bus and Stop responses are printed already, never empty
+      for (; next < end; ++next) {
+        if (answered.printed[next].empty()) {
+          output.Add(*response++);
+        } else {
+          output.AddPrinted(answered.printed[next]);
+          string().swap(answered.printed[next]);
+        }
+      }
+    };
+    for (size_t i = 0; i < count; ++i) {
+      if (NeedsRouter(answered.requests[i])) {
+        window.push_back(move(answered.requests[i]));
+        if (window.size() == stream_window) {
+          flush(i + 1);
+        }
       }
-      stream << response << endl;
     }
-    if (i < responses.size() - 1) stream << "\t},\n";
-    else stream << "\t}\n";
-    ++i;
+    flush(count);
+    output.Finish();
+    return;
   }
-  stream << "]"; 
+
+  vector<char> needs_router(count);
+  vector<StatRequest> routed;
+  for (size_t i = 0; i < count; ++i) {
+    needs_router[i] = NeedsRouter(answered.requests[i]);
+    if (needs_router[i]) {
+      routed.push_back(move(answered.requests[i]));
+    }
+  }
+  vector<Response> responses;
+  {
+    METRICS_SCOPE("stat_requests_process");
+    responses = ProcessRequests(routed, manager);
+  }
+
+  METRICS_SCOPE("print_responses");
+  stream << "[\n";
+  auto response = responses.begin();
+  for (size_t i = 0; i < count; ++i) {
+    if (needs_router[i]) {
+      PrintResponse(*response++, stream);
+    } else {
+      stream << answered.printed[i];
+    }
+    stream << (i + 1 < count ? ",\n" : "\n");
+  }
+  stream << "]";
 }
 
-std::pair<int, double> ReadSettings(const Json::Node& document, std::stringstream& input_info) {
-    pair<int, double> result;
+RoutingSettings ReadSettings(const Json::Node& document) {
+    RoutingSettings result;
     const auto& settings_map = document.AsMap().at("routing_settings").AsMap();
-    result = make_pair(static_cast<int>(settings_map.at("bus_wait_time").AsDouble()), 
-      settings_map.at("bus_velocity").AsDouble() * 1000 / 60);
-
-    input_info << "routing_settings: { bus_wait_time: " << result.first << ", bus_velocity: " << result.second << "\n";
+    result.bus_wait_time = static_cast<int>(settings_map.at("bus_wait_time").AsDouble());
+    result.bus_velocity = settings_map.at("bus_velocity").AsDouble() * 1000 / 60;
+    if (const auto it = settings_map.find("graph_layout"); it != settings_map.end()) {
+      result.layout = it->second.AsString() == "spatial" ? GraphLayout::SPATIAL : GraphLayout::HASH;
+    }
+    if (const auto it = settings_map.find("router"); it != settings_map.end()) {
+      const auto& mode = it->second.AsString();
+      result.router = mode == "dijkstra" ? RouterMode::DIJKSTRA
+                    : mode == "astar" ? RouterMode::A_STAR
+                    : mode == "alt" ? RouterMode::ALT
+                    : mode == "bidirectional" ? RouterMode::BIDIRECTIONAL
+                    : mode == "raptor" ? RouterMode::RAPTOR
+                    : mode == "tree_cache" ? RouterMode::TREE_CACHE
+                    : mode == "hub_labels" ? RouterMode::HUB_LABELS
+                    : mode == "crp" ? RouterMode::CRP
+                    : RouterMode::ALL_PAIRS;
+    }
+    if (const auto it = settings_map.find("landmarks"); it != settings_map.end()) {
+      result.landmark_count = static_cast<size_t>(it->second.AsDouble());
+    }
+    if (const auto it = settings_map.find("pedestrian_velocity"); it != settings_map.end()) {
+      result.pedestrian_velocity = it->second.AsDouble() * 1000 / 60;
+    }
+    if (const auto it = settings_map.find("access_stops"); it != settings_map.end()) {
+      result.access_stop_count = static_cast<size_t>(it->second.AsDouble());
+    }
+    if (const auto it = settings_map.find("merge_parallel_edges"); it != settings_map.end()) {
+      result.merge_parallel_edges = it->second.AsBool();
+    }
+    if (const auto it = settings_map.find("prune_dominated_edges"); it != settings_map.end()) {
+      result.prune_dominated_edges = it->second.AsBool();
+    }
+    if (const auto it = settings_map.find("tree_cache_mb"); it != settings_map.end()) {
+      result.tree_cache_bytes = static_cast<size_t>(it->second.AsDouble() * 1024 * 1024);
+    }
 
   return result;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <string_view>
 #include <optional>
 #include <deque>
+#include <variant>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
@@ -24,159 +25,231 @@ int ConvertToInt(std::string_view str);
 
 double ConvertToDouble(std::string_view str);
 
-struct Request;
-using RequestHolder = std::unique_ptr<Request>;
-using RequestMap  = std::map<std::string, Json::Node>;
-using RequestArray = std::vector<Json::Node>;
+using RequestMap  = Json::Dict;
+using RequestArray = Json::Array;
 
-struct Request {
-  enum class Type {
-    ADD_STOP,
-    ADD_ROUTE,
-    READ_ROUTE,
-    READ_STOP,
-    READ_SEARCH_ROUTE
-  };
+// a point given by "latitude" and "longitude"
+Coordinate ParseCoordinate(const RequestMap& map);
 
-  Request(Type type) : type(type) {}
+// Requests are plain values. NAME is the "type" of the request in the
+// input; a family's variant lists the requests one section may hold.
 
-  virtual void ParseFrom(const RequestMap& map) = 0;
-  virtual ~Request() = default;
-  static RequestHolder Create(Type type);
+struct AddStopRequest {
+  static constexpr std::string_view NAME = "Stop";
+  void ParseFrom(const RequestMap& map);
+  void Process(RouteManager& manager) const;
 
-  const Type type;
-};
-
-const std::unordered_map<std::string_view, Request::Type> STR_TO_UPDATE_REQUEST_TYPE = {
-    {"Stop", Request::Type::ADD_STOP},
-    {"Bus", Request::Type::ADD_ROUTE}
-};
-
-const std::unordered_map<std::string_view, Request::Type> STR_TO_READ_REQUEST_TYPE = {
-    {"Bus", Request::Type::READ_ROUTE},
-    {"Stop", Request::Type::READ_STOP},
-    {"Route", Request::Type::READ_SEARCH_ROUTE}
+  double lat;
+  double lon;
+  std::string stop;
+  RouteManager::DistInfo other_stops;
 };
 
-template <typename ResultType>
-struct StatRequest : Request {
-  using Request::Request;
-  virtual ResultType Process(const RouteManager& manager) const = 0;
+struct AddRouteRequest {
+  static constexpr std::string_view NAME = "Bus";
+  void ParseFrom(const RequestMap& map);
+  void Process(RouteManager& manager) const;
 
-  int request_id;
-};
-
-struct BaseRequest : Request {
-  using Request::Request;
-  virtual void Process(RouteManager& manager) const = 0;
+  std::string route;
+  std::vector<std::string> stops;
+  bool is_roundtrip;
+  std::vector<double> departures;
 };
 
-struct ReadRouteRequest : StatRequest<ResponseHolder> {
-  ReadRouteRequest() : StatRequest(Type::READ_ROUTE) {}
+struct ReadRouteRequest {
+  static constexpr std::string_view NAME = "Bus";
 
-  void ParseFrom(const RequestMap& map) override{
+  void ParseFrom(const RequestMap& map) {
     route = map.at("name").AsString();
     request_id = static_cast<int>(map.at("id").AsDouble());
   }
-  ResponseHolder Process(const RouteManager& manager) const override{
+  ReadRouteResponse Process(const RouteManager& manager) const {
     return manager.ReadRoute(route, request_id);
   }
 
   std::string route;
+  int request_id;
 };
 
-struct ReadStopRequest : StatRequest<ResponseHolder> {
-  ReadStopRequest() : StatRequest(Type::READ_STOP) {}
+struct ReadStopRequest {
+  static constexpr std::string_view NAME = "Stop";
 
-  void ParseFrom(const RequestMap& map) override {
+  void ParseFrom(const RequestMap& map) {
     stop = map.at("name").AsString();
     request_id = static_cast<int>(map.at("id").AsDouble());
   }
-  ResponseHolder Process(const RouteManager& manager) const override {
+  ReadStopResponse Process(const RouteManager& manager) const {
     return manager.ReadStop(stop, request_id);
   }
 
   std::string stop;
+  int request_id;
 };
 
-struct ReadRouteSearchRequest : StatRequest<ResponseHolder> {
-  ReadRouteSearchRequest() : StatRequest(Type::READ_SEARCH_ROUTE) {}
+struct ReadRouteSearchRequest {
+  static constexpr std::string_view NAME = "Route";
 
-  void ParseFrom(const RequestMap& map) override {
-    //do smth
+  void ParseFrom(const RequestMap& map) {
+    ParsePlace(map.at("from"), from, from_point);
+    ParsePlace(map.at("to"), to, to_point);
+    request_id = static_cast<int>(map.at("id").AsDouble());
+    if (const auto it = map.find("alternatives"); it != map.end()) {
+      alternatives = static_cast<size_t>(it->second.AsDouble());
+    }
+    if (const auto it = map.find("departure_time"); it != map.end()) {
+      departure_time = it->second.AsDouble();
+    }
+  }
+  ReadRouteSearchResponse Process(const RouteManager& manager) const {
+    if (from_point || to_point) {
+      return manager.ReadRouteSearchBetween(from_point ? Place(*from_point) : Place(from),
+                                            to_point ? Place(*to_point) : Place(to), request_id);
+    }
+    if (departure_time) {
+      return manager.ReadRouteSearchAt(from, to, request_id, *departure_time);
+    }
+    return manager.ReadRouteSearch(from, to, request_id, alternatives);
+  }
+
+  // between two stops, for the fastest itinerary alone: these can be
+  // answered together with others from the same stop
+  bool IsPlain() const {
+    return !from_point && !to_point && !departure_time && alternatives == 0;
+  }
+
+  // a stop name, or a {"latitude", "longitude"} object for a point
+  static void ParsePlace(const Json::Node& node, std::string& name, std::optional<Coordinate>& point) {
+    if (node.IsMap()) {
+      point = ParseCoordinate(node.AsMap());
+    } else {
+      name = node.AsString();
+    }
+  }
+
+  std::string from, to;
+  // set for an end given by coordinates; the name is then empty
+  std::optional<Coordinate> from_point, to_point;
+  int request_id;
+  // how many next fastest itineraries to add to the fastest one
+  size_t alternatives = 0;
+  // minutes since midnight; set, the timetable answers instead of the router
+  std::optional<double> departure_time;
+};
+
+struct ReadParetoRouteRequest {
+  static constexpr std::string_view NAME = "ParetoRoute";
+
+  void ParseFrom(const RequestMap& map) {
     from = map.at("from").AsString();
     to = map.at("to").AsString();
     request_id = static_cast<int>(map.at("id").AsDouble());
   }
-  ResponseHolder Process(const RouteManager& manager) const override {
-    return manager.ReadRouteSearch(from, to, request_id);
+  ReadParetoRouteResponse Process(const RouteManager& manager) const {
+    return manager.ReadParetoRoute(from, to, request_id);
   }
+
   std::string from, to;
+  int request_id;
 };
 
-struct AddStopRequest : BaseRequest {
-  AddStopRequest() : BaseRequest(Type::ADD_STOP) {}
-  void ParseFrom(const RequestMap& map) override;
-  void Process(RouteManager& manager) const override;
+struct ReadNearestStopsRequest {
+  static constexpr std::string_view NAME = "NearestStops";
 
-  double lat;
-  double lon;
-  std::string stop;
-  RouteManager::DistInfo other_stops;
+  void ParseFrom(const RequestMap& map) {
+    point = ParseCoordinate(map);
+    request_id = static_cast<int>(map.at("id").AsDouble());
+    if (const auto it = map.find("count"); it != map.end()) {
+      count = static_cast<size_t>(it->second.AsDouble());
+    }
+  }
+  ReadNearestStopsResponse Process(const RouteManager& manager) const {
+    return manager.ReadNearestStops(point, count, request_id);
+  }
+
+  Coordinate point;
+  size_t count = 1;
+  int request_id;
 };
 
-struct AddRouteRequest : BaseRequest {
-  AddRouteRequest() : BaseRequest(Type::ADD_ROUTE) {}
-  void ParseFrom(const RequestMap& map) override;
-  void Process(RouteManager& manager) const override;
+using BaseRequest = std::variant<AddStopRequest, AddRouteRequest>;
+using StatRequest = std::variant<ReadRouteRequest, ReadStopRequest, ReadRouteSearchRequest,
+                                 ReadParetoRouteRequest, ReadNearestStopsRequest>;
 
-  std::string route;
-  std::vector<std::string> stops;
-  bool is_roundtrip;
+// request families: the section of the input they are read from and the
+// variant that holds them
+struct BaseRequests {
+  using Request = BaseRequest;
+  static constexpr char SECTION[] = "base_requests";
 };
 
-std::optional<Request::Type> ConvertBaseRequestType(std::string_view type_str);
-
-std::optional<Request::Type> ConvertStatRequestType(std::string_view type_str);
+struct StatRequests {
+  using Request = StatRequest;
+  static constexpr char SECTION[] = "stat_requests";
+};
 
-template<int SIGN>
-RequestHolder ParseRequest(const RequestMap& map) {
-  const auto request_type = SIGN == 0 ? 
-        ConvertBaseRequestType(map.at("type").AsString()) :
-        ConvertStatRequestType(map.at("type").AsString());
-    
-  if (!request_type) {
-    return nullptr;
+// the default-constructed alternative whose NAME matches, if any
+template <typename Variant, size_t I = 0>
+std::optional<Variant> CreateRequest(std::string_view type) {
+  if constexpr (I == std::variant_size_v<Variant>) {
+    return std::nullopt;
+  } else {
+    using Alternative = std::variant_alternative_t<I, Variant>;
+    if (type == Alternative::NAME) {
+      return Variant(std::in_place_index<I>);
+    }
+    return CreateRequest<Variant, I + 1>(type);
   }
-  RequestHolder request = Request::Create(*request_type);
+}
+
+template <typename Family>
+std::optional<typename Family::Request> ParseRequest(const RequestMap& map) {
+  auto request = CreateRequest<typename Family::Request>(map.at("type").AsString());
   if (request) {
-    request->ParseFrom(map);
-  };
+    std::visit([&map](auto& alternative) { alternative.ParseFrom(map); }, *request);
+  }
   return request;
 }
 
-template<int SIGN>
-std::vector<RequestHolder> ReadRequests(const Json::Node& document) {
-  static_assert(SIGN == 0 || SIGN == 1);
-  
-  const RequestArray& json_requests = (SIGN == 0) ?
-    document.AsMap().at("base_requests").AsArray() :
-    document.AsMap().at("stat_requests").AsArray();
+template <typename Family>
+std::vector<typename Family::Request> ReadRequests(const Json::Node& document) {
+  const RequestArray& json_requests = document.AsMap().at(Family::SECTION).AsArray();
 
-  std::vector<RequestHolder> requests;
+  std::vector<typename Family::Request> requests;
   requests.reserve(json_requests.size());
-  
+
   for (const auto& node : json_requests) {
-    if (auto request = ParseRequest<SIGN>(node.AsMap())) {
-      requests.push_back(move(request));
+    if (auto request = ParseRequest<Family>(node.AsMap())) {
+      requests.push_back(std::move(*request));
     }
   }
   return requests;
 }
 
-std::vector<ResponseHolder> ProcessRequests(const std::vector<RequestHolder>& requests,
-    RouteManager& manager);
+void ProcessRequests(const std::vector<BaseRequest>& requests, RouteManager& manager);
+
+Response ProcessRequest(const StatRequest& request, const RouteManager& manager);
+
+// responses in request order; plain Route requests sharing a source stop
+// are answered by one search
+std::vector<Response> ProcessRequests(const std::vector<StatRequest>& requests,
+    const RouteManager& manager);
+
+// one response object, tab-indented as inside the response array
+void PrintResponse(const Response& response, std::ostream& stream);
+
+void PrintResponses(const std::vector<Response>& responses, std::ostream& stream = std::cout);
+
+// Bus and Stop requests read the base data alone, not the graph or router
+bool NeedsRouter(const StatRequest& request);
 
-void PrintResponses(const std::vector<ResponseHolder>& responses, std::stringstream& input_info, std::ostream& stream = std::cout);
+// Builds the graph and router of a manager holding the base requests of
+// the document while another thread parses its stat requests and answers
+// and prints the ones that need no router; the rest are answered once the
+// router is ready. Prints what RunGraphBuilder, ProcessRequests and
+// PrintResponses in turn would. With a stream_window, the rest are answered
+// that many at a time and streamed out through a ResponseStream, so only
+// one window of responses is ever held.
+void BuildAndAnswer(const Json::Node& document, const RoutingSettings& settings,
+    RouteManager& manager, std::ostream& stream, size_t stream_window = 0);
 
-std::pair<int, double> ReadSettings(const Json::Node& document, std::stringstream& input_info);
\ No newline at end of file
+RoutingSettings ReadSettings(const Json::Node& document);
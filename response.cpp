@@ -1,10 +1,11 @@
 #include "response.h"
+#include <algorithm>
 #include <iostream>
 
 
 
 std::ostream& operator << (std::ostream& output, 
-    const ReadRouteResponse data){
+    const ReadRouteResponse& data){
     using std::operator""s;
     output << std::fixed << std::setprecision(6);
 
@@ -27,7 +28,7 @@ std::ostream& operator << (std::ostream& output,
 }
 
 std::ostream& operator << (std::ostream& output,
-    const ReadStopResponse data){
+    const ReadStopResponse& data){
     using std::operator""s;
     output << "\t\t\"" << "request_id"s << "\"" << ": ";
     output << data.request_id << ",\n";
@@ -58,6 +59,44 @@ std::ostream& operator << (std::ostream& output,
 }
 
 
+// the legs of an itinerary, each object opened at the given indentation
+static void PrintItems(std::ostream& output, const std::vector<RouteSearchStats>& items,
+        std::string_view indent) {
+    using std::operator""s;
+    int i = 0;
+    for (const auto& item : items) {
+        output << indent << "{\n";
+        if (const auto* wait = std::get_if<WaitRouteSearchStats>(&item)) {
+            output << indent << "\t\"" << "type"s << "\"" << ": \""  << "Wait"s << "\",\n";
+            output << indent << "\t\"" << "stop_name"s << "\"" << ": \"" << wait->stop_name_ << "\",\n";
+            // a fixed boarding wait is whole minutes, a timetable one need not be
+            output << indent << "\t\"" << "time"s << "\"" << ": ";
+            if (wait->time_ == std::floor(wait->time_))
+                output << static_cast<int>(wait->time_) << "\n";
+            else
+                output << wait->time_ << "\n";
+        }
+        else if (const auto* walk = std::get_if<WalkRouteSearchStats>(&item)) {
+            output << indent << "\t\"" << "type"s << "\"" << ": \""  << "Walk"s << "\",\n";
+            if (!walk->stop_name_.empty())
+                output << indent << "\t\"" << "stop_name"s << "\"" << ": \"" << walk->stop_name_ << "\",\n";
+            output << indent << "\t\"" << "time"s << "\"" << ": " << walk->time_ << "\n";
+        }
+        else {
+            const auto& bus = std::get<BusRouteSearchStats>(item);
+            output << indent << "\t\"" << "type"s << "\"" << ": \""  << "Bus"s << "\",\n";
+            output << indent << "\t\"" << "bus"s << "\"" << ": \"" << bus.bus_name_ << "\",\n";
+            output << indent << "\t\"" << "span_count"s << "\"" << ": " << bus.span_count_ << ",\n";
+            output << indent << "\t\"" << "time"s << "\"" << ": " << bus.time_ << "\n";
+        }
+        if (i == items.size() - 1)
+            output << indent << "}\n";
+        else
+            output << indent << "},\n";
+        ++i;
+    }
+}
+
 std::ostream& operator << (std::ostream& output,
     const ReadRouteSearchResponse& data) {
     //do stmth;
@@ -75,31 +114,74 @@ std::ostream& operator << (std::ostream& output,
     output << "\t\t\"" << "total_time"s << "\"" << ": "
            << data.total_time << ",\n"
            << "\t\t\"" << "items"s << "\"" << ": [\n";
-    int i = 0;
-    for (const auto& item : *data.stats) {
-        output << "\t\t\t{\n";
-        if (item->type_ == RouteSearchStats::Type::WAIT) {
-            const auto& cur_stat = static_cast<const WaitRouteSearchStats&>(*item);
-            output << "\t\t\t\t\"" << "type"s << "\"" << ": \""  << "Wait"s << "\",\n";
-            output << "\t\t\t\t\"" << "stop_name"s << "\"" << ": \"" << cur_stat.stop_name_ << "\",\n";
-            output << "\t\t\t\t\"" << "time"s << "\"" << ": " << static_cast<int>(cur_stat.time_) << "\n";
-        }
-        else if (item->type_ == RouteSearchStats::Type::BUS) {
-            const auto& cur_stat = static_cast<const BusRouteSearchStats&>(*item);
-            output << "\t\t\t\t\"" << "type"s << "\"" << ": \""  << "Bus"s << "\",\n";
-            output << "\t\t\t\t\"" << "bus"s << "\"" << ": \"" << cur_stat.bus_name_ << "\",\n";
-            output << "\t\t\t\t\"" << "span_count"s << "\"" << ": " << cur_stat.span_count_ << ",\n";
-            output << "\t\t\t\t\"" << "time"s << "\"" << ": " << cur_stat.time_ << "\n";
-        }
-        if (i == data.stats->size() - 1)
-            output << "\t\t\t}\n";
-        else
-            output << "\t\t\t},\n";
-        ++i;
+    PrintItems(output, *data.stats, "\t\t\t");
+    output << "\t\t]";
+    if (data.alternatives.empty()) {
+        return output;
+    }
+
+    output << ",\n\t\t\"" << "alternatives"s << "\"" << ": [\n";
+    for (size_t i = 0; i < data.alternatives.size(); ++i) {
+        const Itinerary& itinerary = data.alternatives[i];
+        output << "\t\t\t{\n"
+               << "\t\t\t\t\"" << "total_time"s << "\"" << ": "
+               << itinerary.total_time << ",\n"
+               << "\t\t\t\t\"" << "items"s << "\"" << ": [\n";
+        PrintItems(output, itinerary.items, "\t\t\t\t\t");
+        output << "\t\t\t\t]\n"
+               << (i + 1 < data.alternatives.size() ? "\t\t\t},\n" : "\t\t\t}\n");
+    }
+    output << "\t\t]";
+    return output;
+}
+std::ostream& operator << (std::ostream& output,
+    const ReadParetoRouteResponse& data) {
+    using std::operator""s;
+    output << std::fixed << std::setprecision(25);
+
+    output << "\t\t\"" << "request_id"s << "\"" << ": ";
+    output << data.request_id << ",\n";
+    if (!data.journeys){
+        output << "\t\t\"" << "error_message"s << "\"" << ": ";
+        return output << "\"" << "not found"s << "\"";
+    }
+
+    output << "\t\t\"" << "journeys"s << "\"" << ": [\n";
+    for (size_t i = 0; i < data.journeys->size(); ++i) {
+        const Itinerary& journey = (*data.journeys)[i];
+        const auto rides = std::count_if(journey.items.begin(), journey.items.end(), [](const auto& item) {
+            return std::holds_alternative<BusRouteSearchStats>(item);
+        });
+        output << "\t\t\t{\n"
+               << "\t\t\t\t\"" << "total_time"s << "\"" << ": "
+               << journey.total_time << ",\n"
+               << "\t\t\t\t\"" << "transfers"s << "\"" << ": "
+               << std::max<decltype(rides)>(rides - 1, 0) << ",\n"
+               << "\t\t\t\t\"" << "items"s << "\"" << ": [\n";
+        PrintItems(output, journey.items, "\t\t\t\t\t");
+        output << "\t\t\t\t]\n"
+               << (i + 1 < data.journeys->size() ? "\t\t\t},\n" : "\t\t\t}\n");
     }
     output << "\t\t]";
     return output;
 }
+
+std::ostream& operator << (std::ostream& output,
+    const ReadNearestStopsResponse& data) {
+    using std::operator""s;
+    output << std::fixed << std::setprecision(6);
+
+    output << "\t\t\"" << "request_id"s << "\"" << ": ";
+    output << data.request_id << ",\n";
+    output << "\t\t\"" << "stops"s << "\"" << ": [";
+    for (size_t i = 0; i < data.stops.size(); ++i) {
+        output << (i ? ",\n" : "\n")
+               << "\t\t\t{\"" << "name"s << "\": \"" << data.stops[i].first << "\", \""
+               << "distance"s << "\": " << data.stops[i].second << "}";
+    }
+    return output << (data.stops.empty() ? "]" : "\n\t\t]");
+}
+
 double ConvertToRad(double val){
     return val * PI / 180;
 }
@@ -111,18 +193,8 @@ double DistanceBetweenCoordinates(const Coordinate& x, const Coordinate& y){
     double lat_y_r = ConvertToRad(y.lat);
     double lon_y_r = ConvertToRad(y.lon);
 
-    return acos(sin(lat_x_r) * sin(lat_y_r) + 
+    // rounding can push the cosine just past 1 for (nearly) equal points
+    return acos(std::min(1.0, sin(lat_x_r) * sin(lat_y_r) + 
             cos(lat_x_r) * cos(lat_y_r) * 
-            cos(std::abs(lon_x_r - lon_y_r))) * RADIUS;
+            cos(std::abs(lon_x_r - lon_y_r)))) * RADIUS;
 }
-
-ResponseHolder Response::Create(Response::Type type) {
-  switch (type) {
-    case Response::Type::SEND_ROUTE:
-      return std::make_unique<ReadRouteResponse>();
-    case Response::Type::SEND_STOP:
-      return std::make_unique<ReadStopResponse>();
-    default:
-      return nullptr;
-  }
-}
\ No newline at end of file
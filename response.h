@@ -4,13 +4,12 @@
 #include <memory>
 #include <sstream>
 #include <optional>
+#include <string_view>
+#include <variant>
 #include <iomanip>
 #include <cmath>
 #include <vector>
 
-struct RouteSearchStats;
-using RouteSearchStatsHolder = std::unique_ptr<RouteSearchStats>;
-
 const double PI = 3.1415926535;
 const double RADIUS = 6371000;
 
@@ -25,74 +24,71 @@ struct StopStats{
     std::set<std::string> routes;
 };
 
-struct RouteSearchStats {
-  enum class Type {
-    WAIT,
-    BUS
-  };
-
-  RouteSearchStats(Type type, double time) : type_(type), time_(time) {}
-  virtual ~RouteSearchStats() = default;
-  const Type type_;
-public:
-  double time_;
-};
-
-struct WaitRouteSearchStats : RouteSearchStats {
-    WaitRouteSearchStats (std::string_view stop_name, double time) : 
-        RouteSearchStats(RouteSearchStats::Type::WAIT, time),
-        stop_name_(stop_name) {}
+struct WaitRouteSearchStats {
     std::string_view stop_name_;
+    double time_;
 };
 
-struct BusRouteSearchStats : RouteSearchStats {
-    BusRouteSearchStats (std::string_view bus_name, int span_count, double time) : 
-        RouteSearchStats(RouteSearchStats::Type::BUS, time),
-        bus_name_(bus_name),
-        span_count_(span_count) {}
+struct BusRouteSearchStats {
     std::string_view bus_name_;
     int span_count_;
+    double time_;
 };
 
+// walking between a point and a stop; no stop name for a walk straight
+// from point to point
+struct WalkRouteSearchStats {
+    std::string_view stop_name_;
+    double time_;
+};
 
-struct Response;
-using ResponseHolder = std::unique_ptr<Response>;
-
-struct Response{
-    enum class Type {
-        SEND_ROUTE,
-        SEND_STOP,
-        SEND_ROUTE_SEARCH
-    };
-
-    Response(Type type) : type(type) {}
-    static ResponseHolder Create(Type type);
-    virtual ~Response() = default;
+// one leg of an itinerary
+using RouteSearchStats = std::variant<WaitRouteSearchStats, BusRouteSearchStats, WalkRouteSearchStats>;
 
-    const Type type;
+struct ReadRouteResponse {
     int request_id;
-};
-
-struct ReadRouteResponse : Response {
-    ReadRouteResponse () : Response(Response::Type::SEND_ROUTE) {}
     std::string route;
     std::optional<RouteStats> stats;
 };
 
-struct ReadStopResponse : Response {
-    ReadStopResponse () : Response(Response::Type::SEND_STOP) {}
+struct ReadStopResponse {
+    int request_id;
     std::string stop;
     bool hasStop;
     std::optional<StopStats> stats;
 };
 
-struct ReadRouteSearchResponse : Response {
-    ReadRouteSearchResponse () : Response(Response::Type::SEND_ROUTE_SEARCH) {} ;
+struct Itinerary {
+    std::vector<RouteSearchStats> items;
+    double total_time;
+};
+
+struct ReadRouteSearchResponse {
+    int request_id;
     std::string from, to;
-    std::optional<std::vector<RouteSearchStatsHolder> > stats;
+    std::optional<std::vector<RouteSearchStats>> stats;
     double total_time;
+    // the next best itineraries, printed only when some were asked for
+    std::vector<Itinerary> alternatives;
 };
 
+struct ReadParetoRouteResponse {
+    int request_id;
+    std::string from, to;
+    // fewest transfers first, each one faster than the one before
+    std::optional<std::vector<Itinerary>> journeys;
+};
+
+struct ReadNearestStopsResponse {
+    int request_id;
+    // stop names and great-circle distances in meters, nearest first
+    std::vector<std::pair<std::string_view, double>> stops;
+};
+
+// answers to stat requests are stored by value, one alternative per request type
+using Response = std::variant<ReadRouteResponse, ReadStopResponse, ReadRouteSearchResponse,
+                              ReadParetoRouteResponse, ReadNearestStopsResponse>;
+
 struct Coordinate{
     double lat;
     double lon;
@@ -101,12 +97,18 @@ struct Coordinate{
 double DistanceBetweenCoordinates(const Coordinate& lhs, const Coordinate& rhs);
 
 std::ostream& operator << (std::ostream& output, 
-    const ReadRouteResponse data);
+    const ReadRouteResponse& data);
 
 std::ostream& operator << (std::ostream& output,
-    const ReadStopResponse data);
+    const ReadStopResponse& data);
 
 std::ostream& operator << (std::ostream& output,
     const ReadRouteSearchResponse& data);
 
+std::ostream& operator << (std::ostream& output,
+    const ReadParetoRouteResponse& data);
+
+std::ostream& operator << (std::ostream& output,
+    const ReadNearestStopsResponse& data);
+
 double ConvertToRad(double val);
@@ -0,0 +1,67 @@
+#include "response_stream.h"
+#include "request.h"
+#include "metrics.h"
+
+using namespace std;
+
+ResponseStream::ResponseStream(ostream& stream, size_t chunk_size, size_t ring_capacity)
+    : stream_(stream), chunk_size_(chunk_size), ring_(ring_capacity) {
+    chunk_.reserve(chunk_size_ + chunk_size_ / 4);
+    chunk_ = "[\n";
+    writer_ = thread([this] {
+        for (string chunk = ring_.Pop(); !chunk.empty(); chunk = ring_.Pop()) {
+            stream_.write(chunk.data(), chunk.size());
+        }
+        stream_.flush();
+    });
+}
+
+ResponseStream::~ResponseStream() {
+    if (!finished_) {
+        Stop();
+    }
+}
+
+void ResponseStream::StartResponse() {
+    if (count_++ > 0) {
+        chunk_ += ",\n";
+    }
+}
+
+void ResponseStream::EndResponse() {
+    if (chunk_.size() >= chunk_size_) {
+        METRICS_COUNT("response_stream_chunks", 1);
+        string next;
+        next.reserve(chunk_size_ + chunk_size_ / 4);
+        ring_.Push(exchange(chunk_, move(next)));
+    }
+}
+
+void ResponseStream::Add(const Response& response) {
+    StartResponse();
+    printer_.str({});
+    PrintResponse(response, printer_);
+    chunk_ += printer_.str();
+    EndResponse();
+}
+
+void ResponseStream::AddPrinted(string_view printed) {
+    StartResponse();
+    chunk_ += printed;
+    EndResponse();
+}
+
+void ResponseStream::Finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    chunk_ += count_ > 0 ? "\n]" : "]";
+    ring_.Push(move(chunk_));
+    Stop();
+}
+
+void ResponseStream::Stop() {
+    ring_.Push(string());
+    writer_.join();
+}
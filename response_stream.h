@@ -0,0 +1,44 @@
+#pragma once
+#include "response.h"
+#include "spsc_ring.h"
+
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Prints responses as the JSON array PrintResponses makes, one at a time
+// as they are ready, so none has to be kept once added. The text gathers
+// into chunks of about chunk_size bytes that a writer thread of its own
+// takes through a ring of ring_capacity chunks and writes to the stream;
+// Add waits while the ring is full.
+class ResponseStream {
+public:
+    explicit ResponseStream(std::ostream& stream, size_t chunk_size = 1 << 16, size_t ring_capacity = 16);
+    // without Finish, as when unwinding, the array is left open and only
+    // the chunks already handed over are written
+    ~ResponseStream();
+
+    void Add(const Response& response);
+    // a response PrintResponse has printed already
+    void AddPrinted(std::string_view printed);
+    // closes the array and waits until the stream has all of it
+    void Finish();
+
+private:
+    void StartResponse();
+    void EndResponse();
+    // ends the writer once it has written what the ring holds
+    void Stop();
+
+    std::ostream& stream_;
+    const size_t chunk_size_;
+    // an empty chunk tells the writer that the array is complete
+    SpscRing<std::string> ring_;
+    std::string chunk_;
+    std::ostringstream printer_;
+    size_t count_ = 0;
+    bool finished_ = false;
+    std::thread writer_;
+};
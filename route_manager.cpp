@@ -1,12 +1,486 @@
 #include "route_manager.h"
+#include "parallel.h"
+#include "metrics.h"
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <tuple>
 using namespace std;
 
-void RouteManager::RunGraphBuilder(std::pair<int, double> routing_settings) {
+void RouteManager::RunGraphBuilder(const RoutingSettings& routing_settings) {
+    BuildGraph(routing_settings);
+    PrecomputeRouter();
+}
+
+size_t RouteManager::BuildGraph(const RoutingSettings& routing_settings) {
+    METRICS_SCOPE("graph_build");
     graphBuilder.emplace(this, routing_settings);
+    METRICS_COUNT("graph_edges", graphBuilder->graph.GetEdgeCount());
+    return graphBuilder->graph.GetEdgeCount();
+}
+
+void RouteManager::PrecomputeRouter() {
+    METRICS_SCOPE("router_precompute");
+    // linear in the route lengths, so ParetoRoute works with every router
+    InitRaptor();
+    InitStopIndex();
+    if (!route_departures_.empty()) {
+        InitTimetable();
+    }
+    switch (graphBuilder->settings.router) {
+    case RouterMode::ALL_PAIRS:
+        graphBuilder->router.emplace(graphBuilder->graph);
+        break;
+    case RouterMode::A_STAR:
+        InitGeoBound();
+        break;
+    case RouterMode::ALT:
+        graphBuilder->landmarks.emplace(graphBuilder->graph, graphBuilder->settings.landmark_count);
+        break;
+    case RouterMode::TREE_CACHE:
+        graphBuilder->tree_cache.emplace(graphBuilder->graph, graphBuilder->settings.tree_cache_bytes);
+        break;
+    case RouterMode::HUB_LABELS:
+        graphBuilder->hub_labels.emplace(graphBuilder->graph);
+        break;
+    case RouterMode::CRP:
+        InitOverlay();
+        break;
+    default:
+        break;
+    }
+}
+
+void RouteManager::UpdateRoutingSettings(const RoutingSettings& routing_settings) {
+    // the edges themselves, and so the partition, stay the same unless
+    // the layout or the edge filters change; pruning depends on the wait
+    const RoutingSettings* current = graphBuilder ? &graphBuilder->settings : nullptr;
+    if (!current || current->router != RouterMode::CRP || routing_settings.router != RouterMode::CRP
+            || current->layout != routing_settings.layout
+            || current->merge_parallel_edges != routing_settings.merge_parallel_edges
+            || current->prune_dominated_edges || routing_settings.prune_dominated_edges) {
+        RunGraphBuilder(routing_settings);
+        return;
+    }
+    METRICS_SCOPE("router_customize");
+    auto& builder = *graphBuilder;
+    builder.settings = routing_settings;
+    // rides weigh their meters, only the waits (in to out vertex) change
+    const GraphWeight wait = GraphBuilder::ToWeight(routing_settings.bus_wait_time, routing_settings);
+    for (Graph::EdgeId edge_id = 0; edge_id < builder.graph.GetEdgeCount(); ++edge_id) {
+        if (builder.graph.GetEdge(edge_id).from % 2 == 0) {
+            builder.graph.SetEdgeWeight(edge_id, wait);
+        }
+    }
+    InitRaptor();
+    if (!route_departures_.empty()) {
+        InitTimetable();
+    }
+    builder.overlay->Customize(routing_settings.build_threads);
+}
+
+const Graph::DirectedWeightedGraph<RouteManager::GraphWeight>& RouteManager::GetGraph() const {
+    return graphBuilder->graph;
+}
+
+void RouteManager::InitStopIndex() {
+    METRICS_SCOPE("stop_index_build");
+    auto& builder = *graphBuilder;
+    builder.stop_coordinates.resize(builder.stop_id_to_name_.size() / 2);
+    for (size_t i = 0; i < builder.stop_coordinates.size(); ++i) {
+        builder.stop_coordinates[i] = stops_.at(builder.stop_id_to_name_[2 * i]);
+    }
+    builder.stop_index.emplace(builder.stop_coordinates);
+}
+
+void RouteManager::InitOverlay() {
+    auto& builder = *graphBuilder;
+    const auto& graph = builder.graph;
+    // Cells are ranges of stops along the Hilbert curve, whatever the
+    // layout, counting only the stops some route serves: 32 of them at the
+    // finest level, 8 times as many at each next one. Both vertices of a
+    // stop share its cells.
+    const size_t finest_cell_size = 32, cell_size_factor = 8;
+    vector<size_t> rank(builder.stop_id_to_name_.size() / 2);
+    size_t linked = 0;
+    for (const string* stop_name : GraphBuilder::OrderStops(stops_, GraphLayout::SPATIAL)) {
+        const size_t stop_id = builder.name_to_stop_id_.at(*stop_name) / 2;
+        rank[stop_id] = linked;
+        const auto edges = graph.GetIncidentEdges(2 * stop_id);
+        const auto incoming = graph.GetIncomingEdges(2 * stop_id);
+        linked += edges.begin() != edges.end() || incoming.begin() != incoming.end();
+    }
+    vector<vector<uint32_t>> cells;
+    for (size_t cell_size = finest_cell_size; linked > cell_size; cell_size *= cell_size_factor) {
+        vector<uint32_t>& cell = cells.emplace_back(graph.GetVertexCount());
+        for (size_t vertex = 0; vertex < cell.size(); ++vertex) {
+            cell[vertex] = static_cast<uint32_t>(min(rank[vertex / 2], linked - 1) / cell_size);
+        }
+    }
+    METRICS_COUNT("overlay_levels", cells.size());
+    builder.overlay.emplace(graph, move(cells));
+    builder.overlay->Customize(builder.settings.build_threads);
+}
+
+void RouteManager::InitGeoBound() {
+    auto& builder = *graphBuilder;
+
+    // A ride covers consecutive route segments, so its road distance is at
+    // least the smallest road/geo ratio of any segment times the great-circle
+    // distance between its ends (triangle inequality on the sphere).
+    double min_ratio = numeric_limits<double>::infinity();
+    auto visit_segment = [&](const string& from, const string& to) {
+        const double geo = from != to ? DistanceBetweenCoordinates(stops_.at(from), stops_.at(to)) : 0;
+        if (geo > 0) {
+            const auto it = distances_.find(make_pair(from, to));
+            min_ratio = min(min_ratio, (it != distances_.end() ? it->second : 0) / geo);
+        }
+    };
+    for (const auto& [route_name, route] : route_to_stops_) {
+        const auto& stops = route.first;
+        for (size_t i = 1; i < stops.size(); ++i) {
+            visit_segment(stops[i - 1], stops[i]);
+            if (!route.second) {
+                visit_segment(stops[i], stops[i - 1]);
+            }
+        }
+    }
+    if (!isfinite(min_ratio)) {
+        min_ratio = 0;
+    }
+    // keep a small margin so rounding never overestimates
+    builder.min_weight_per_meter = min_ratio * GraphBuilder::UNITS_PER_METER * (1 - 1e-9);
+}
+
+void RouteManager::InitRaptor() {
+    auto& builder = *graphBuilder;
+    vector<const RoutesData::value_type*> routes;
+    routes.reserve(route_to_stops_.size());
+    for (const auto& route : route_to_stops_) {
+        routes.push_back(&route);
+    }
+    if (builder.settings.layout != GraphLayout::HASH) {
+        sort(begin(routes), end(routes), [](const auto* lhs, const auto* rhs) {
+            return lhs->first < rhs->first;
+        });
+    }
+
+    // a roundtrip is ridden one way, any other route there and back
+    vector<Raptor::Pattern> patterns;
+    vector<int> forward, backward;
+    for (const auto* route : routes) {
+        const auto& [stops, is_roundtrip] = route->second;
+        const int n = stops.size();
+        AccumulateDistances(stops, distances_, forward, backward);
+        Raptor::Pattern there{route->first, {}, forward};
+        for (const string& stop : stops) {
+            there.stops.push_back(builder.name_to_stop_id_.at(stop) / 2);
+        }
+        if (!is_roundtrip) {
+            Raptor::Pattern back{route->first, {there.stops.rbegin(), there.stops.rend()}, vector<int>(n)};
+            for (int i = 0; i < n; ++i) {
+                back.distances[i] = backward[n - 1] - backward[n - 1 - i];
+            }
+            patterns.push_back(move(back));
+        }
+        patterns.push_back(move(there));
+    }
+    builder.raptor.emplace(stops_.size(), move(patterns),
+                           static_cast<double>(builder.settings.bus_wait_time), builder.settings.bus_velocity);
+}
+
+void RouteManager::InitTimetable() {
+    auto& builder = *graphBuilder;
+    vector<const RoutesData::value_type*> routes;
+    for (const auto& route : route_to_stops_) {
+        if (route_departures_.count(route.first)) {
+            routes.push_back(&route);
+        }
+    }
+    sort(begin(routes), end(routes), [](const auto* lhs, const auto* rhs) {
+        return lhs->first < rhs->first;
+    });
+
+    vector<Timetable::Schedule> schedules;
+    schedules.reserve(routes.size());
+    vector<int> forward, backward;
+    for (const auto* route : routes) {
+        const auto& [stops, is_roundtrip] = route->second;
+        const int n = stops.size();
+        AccumulateDistances(stops, distances_, forward, backward);
+        Timetable::Schedule schedule{route->first, {}, {}, route_departures_.at(route->first)};
+        for (int i = 0; i < n; ++i) {
+            schedule.stops.push_back(builder.name_to_stop_id_.at(stops[i]) / 2);
+            schedule.minutes.push_back(forward[i] / builder.settings.bus_velocity);
+        }
+        if (!is_roundtrip) {
+            for (int i = n - 2; i >= 0; --i) {
+                schedule.stops.push_back(builder.name_to_stop_id_.at(stops[i]) / 2);
+                schedule.minutes.push_back((forward[n - 1] + backward[n - 1] - backward[i]) / builder.settings.bus_velocity);
+            }
+        }
+        schedules.push_back(move(schedule));
+    }
+    builder.timetable.emplace(stops_.size(), schedules);
+}
+
+optional<RouteManager::GraphBuilder::Path> RouteManager::FindRoute(size_t vertex_from, size_t vertex_to) const {
+    const auto& builder = *graphBuilder;
+    switch (builder.settings.router) {
+    case RouterMode::ALL_PAIRS: {
+        const auto route_info = builder.router->BuildRoute(vertex_from, vertex_to);
+        if (!route_info) {
+            return nullopt;
+        }
+        GraphBuilder::Path path{route_info->weight, {}};
+        path.edges.reserve(route_info->edge_count);
+        for (size_t i = 0; i < route_info->edge_count; ++i) {
+            path.edges.push_back(builder.router->GetRouteEdge(route_info->id, i));
+        }
+        builder.router->ReleaseRoute(route_info->id);
+        return path;
+    }
+    case RouterMode::A_STAR: {
+        const Coordinate& target = builder.stop_coordinates[vertex_to / 2];
+        return builder.search.FindPath(vertex_from, vertex_to, [&](Graph::VertexId vertex) {
+            return static_cast<GraphWeight>(DistanceBetweenCoordinates(builder.stop_coordinates[vertex / 2], target)
+                * builder.min_weight_per_meter);
+        });
+    }
+    case RouterMode::ALT:
+        return builder.search.FindPath(vertex_from, vertex_to, builder.landmarks->TowardsTarget(vertex_to));
+    case RouterMode::BIDIRECTIONAL:
+        return builder.search.FindPathBidirectional(vertex_from, vertex_to);
+    case RouterMode::TREE_CACHE:
+        return builder.tree_cache->FindPath(vertex_from, vertex_to);
+    case RouterMode::HUB_LABELS:
+        return builder.hub_labels->FindPath(vertex_from, vertex_to);
+    case RouterMode::CRP:
+        return builder.overlay->FindPath(vertex_from, vertex_to);
+    default:
+        return builder.search.FindPath(vertex_from, vertex_to);
+    }
+}
+
+// position of the cell (x, y) along the Hilbert curve filling a 2^16 x 2^16 grid
+static uint64_t HilbertIndex(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t half = 1u << 15; half > 0; half /= 2) {
+        const uint32_t rx = (x & half) > 0;
+        const uint32_t ry = (y & half) > 0;
+        index += static_cast<uint64_t>(half) * half * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = half - 1 - x;
+                y = half - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+
+vector<const string*> RouteManager::GraphBuilder::OrderStops(const StopsData& stops, GraphLayout layout) {
+    vector<const string*> result;
+    result.reserve(stops.size());
+    for (const auto& [stop_name, coord] : stops) {
+        result.push_back(&stop_name);
+    }
+    if (layout == GraphLayout::HASH || stops.empty()) {
+        return result;
+    }
+
+    double min_lat = 90, max_lat = -90, min_lon = 180, max_lon = -180;
+    for (const auto& [stop_name, coord] : stops) {
+        min_lat = min(min_lat, coord.lat);
+        max_lat = max(max_lat, coord.lat);
+        min_lon = min(min_lon, coord.lon);
+        max_lon = max(max_lon, coord.lon);
+    }
+    auto to_cell = [](double value, double low, double high) {
+        return high > low ? static_cast<uint32_t>((value - low) / (high - low) * 65535) : 0u;
+    };
+
+    vector<pair<uint64_t, const string*>> keyed;
+    keyed.reserve(stops.size());
+    for (const string* stop_name : result) {
+        const Coordinate& coord = stops.at(*stop_name);
+        keyed.emplace_back(HilbertIndex(to_cell(coord.lon, min_lon, max_lon),
+                                        to_cell(coord.lat, min_lat, max_lat)), stop_name);
+    }
+    // names break ties between stops that fall into the same cell
+    sort(begin(keyed), end(keyed), [](const auto& lhs, const auto& rhs) {
+        return tie(lhs.first, *lhs.second) < tie(rhs.first, *rhs.second);
+    });
+    for (size_t i = 0; i < keyed.size(); ++i) {
+        result[i] = keyed[i].second;
+    }
+    return result;
+}
+
+vector<string_view>
+RouteManager::GraphBuilder::InitEdgeIdToRouteName(const RouteManager * manager, 
+        const RoutingSettings& settings) {
+    // RAPTOR answers from the stop sequences alone
+    if (settings.router == RouterMode::RAPTOR) {
+        return {};
+    }
+    vector<const RoutesData::value_type*> routes;
+    routes.reserve(manager->route_to_stops_.size());
+    for (const auto& route : manager->route_to_stops_) {
+        routes.push_back(&route);
+    }
+    if (settings.layout != GraphLayout::HASH) {
+        sort(begin(routes), end(routes), [](const auto* lhs, const auto* rhs) {
+            return lhs->first < rhs->first;
+        });
+    }
+
+    // first pass: edge offsets of every route
+    vector<size_t> offsets(routes.size() + 1, 0);
+    for (size_t i = 0; i < routes.size(); ++i) {
+        offsets[i + 1] = offsets[i] + CountRouteEdges(routes[i]->second);
+    }
+
+    // second pass: workers fill disjoint slices of the preallocated arrays
+    vector<Graph::Edge<WeightType>> edges(offsets.back());
+    vector<string_view> result(offsets.back());
+    vector<char> dominated(settings.prune_dominated_edges ? offsets.back() : 0, 0);
+    ParallelFor(routes.size(), settings.build_threads, [&](size_t i) {
+        FillRouteEdges(*routes[i], manager->distances_, settings, offsets[i], edges, result, dominated);
+    });
+
+    if (settings.prune_dominated_edges) {
+        size_t kept = 0;
+        for (size_t edge_id = 0; edge_id < edges.size(); ++edge_id) {
+            if (!dominated[edge_id]) {
+                edges[kept] = edges[edge_id];
+                result[kept] = result[edge_id];
+                ++kept;
+            }
+        }
+        METRICS_COUNT("graph_dominated_edges", edges.size() - kept);
+        edges.resize(kept);
+        result.resize(kept);
+    }
+    // routes sharing a stretch of road give parallel edges, and only the
+    // lightest can be on a path a search finds; its route names the leg
+    if (settings.merge_parallel_edges) {
+        const auto kept = Graph::MergeParallelEdges(graph.GetVertexCount(), edges);
+        METRICS_COUNT("graph_parallel_edges", result.size() - kept.size());
+        for (size_t edge_id = 0; edge_id < kept.size(); ++edge_id) {
+            result[edge_id] = result[kept[edge_id]];
+        }
+        result.resize(kept.size());
+    }
+
+    graph = Graph::DirectedWeightedGraph<WeightType>(graph.GetVertexCount(), move(edges));
+    return result;
+}
+
+void RouteManager::AccumulateDistances(const vector<string>& stops,
+        const Distances& distances, vector<int>& forward, vector<int>& backward) {
+    const size_t n = stops.size();
+    forward.assign(n, 0);
+    backward.assign(n, 0);
+    for (size_t i = 1; i < n; ++i) {
+        const auto there = distances.find(make_pair(stops[i - 1], stops[i]));
+        const auto back = distances.find(make_pair(stops[i], stops[i - 1]));
+        forward[i] = forward[i - 1] + (there != distances.end() ? there->second : 0);
+        backward[i] = backward[i - 1] + (back != distances.end() ? back->second : 0);
+    }
+}
+
+size_t RouteManager::GraphBuilder::CountRouteEdges(const RouteInfo& route) {
+    const size_t n = route.first.size();
+    // every stop gets a wait edge, plus a ride edge to each reachable stop
+    return route.second
+        ? n + n * (n + 1) / 2
+        : n + n * (n - 1);
 }
-ResponseHolder RouteManager::ReadRoute(string route, int request_id) const{
+
+void RouteManager::GraphBuilder::FillRouteEdges(const RoutesData::value_type& route, 
+        const Distances& distances, const RoutingSettings& settings, size_t first_edge_id,
+        vector<Graph::Edge<WeightType>>& edges, vector<string_view>& edge_routes,
+        vector<char>& dominated) const {
+    const string_view route_name = route.first;
+    const auto& stops = route.second.first;
+    const int n = stops.size();
+
+    // any ride is a difference of two entries
+    vector<int> forward, backward;
+    AccumulateDistances(stops, distances, forward, backward);
+
+    size_t edge_id = first_edge_id;
+    auto add_edge = [&](size_t from, size_t to, WeightType weight, bool is_dominated) {
+        edges[edge_id] = {from, to, weight};
+        edge_routes[edge_id] = route_name;
+        if (is_dominated) {
+            dominated[edge_id] = 1;
+        }
+        ++edge_id;
+    };
+    auto stop_id = [&](int i) -> size_t { return name_to_stop_id_.at(stops[i]); };
+    const WeightType wait = ToWeight(settings.bus_wait_time, settings);
+
+    // A ride passing a loop of the route, from a stop back to itself that
+    // takes longer than a wait, loses to getting off at the loop's start
+    // and on again at its end. loop_forward[t] is the latest start k < t
+    // of such a loop ending at t (-1 if none), loop_backward[t] the
+    // earliest k > t on the way back (n if none).
+    vector<int> loop_forward(n, -1), loop_backward(n, n);
+    if (settings.prune_dominated_edges) {
+        for (int t = 0; t < n; ++t) {
+            for (int k = 0; k < n; ++k) {
+                if (k == t || stops[k] != stops[t]) {
+                    continue;
+                }
+                if (k < t && (forward[t] - forward[k]) * UNITS_PER_METER > wait) {
+                    loop_forward[t] = k;
+                }
+                if (k > t && loop_backward[t] == n && (backward[k] - backward[t]) * UNITS_PER_METER > wait) {
+                    loop_backward[t] = k;
+                }
+            }
+        }
+    }
+
+    // build edges for roundtrip route
+    if (route.second.second) {
+        for (int i = 0; i < n; ++i) {
+            const size_t stop_id_from = stop_id(i) + 1;
+            add_edge(stop_id_from - 1, stop_id_from, wait, false);
+            bool is_dominated = false;
+            for (int j = i; j < n; ++j) {
+                is_dominated = is_dominated || (j - 1 > i && loop_forward[j - 1] > i);
+                add_edge(stop_id_from, stop_id(j), (forward[j] - forward[i]) * UNITS_PER_METER, is_dominated);
+            }
+        }
+    }
+    // build edges for ordinary route
+    else {
+        for (int i = 0; i < n; ++i) {
+            const size_t stop_id_from = stop_id(i) + 1;
+            add_edge(stop_id_from - 1, stop_id_from, wait, false);
+            bool is_dominated = false;
+            for (int j = i + 1; j < n; ++j) {
+                is_dominated = is_dominated || (j - 1 > i && loop_forward[j - 1] > i);
+                add_edge(stop_id_from, stop_id(j), (forward[j] - forward[i]) * UNITS_PER_METER, is_dominated);
+            }
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            const size_t stop_id_from = stop_id(i) + 1;
+            bool is_dominated = false;
+            for (int j = i - 1; j >= 0; j--) {
+                is_dominated = is_dominated || (j + 1 < i && loop_backward[j + 1] < i);
+                add_edge(stop_id_from, stop_id(j), (backward[i] - backward[j]) * UNITS_PER_METER, is_dominated);
+            }
+        }
+    }
+}
+ReadRouteResponse RouteManager::ReadRoute(string route, int request_id) const{
     ReadRouteResponse response;
 
     response.request_id = request_id;
@@ -38,10 +512,10 @@ ResponseHolder RouteManager::ReadRoute(string route, int request_id) const{
     else{
         response.stats = nullopt;
     }
-    return make_unique<ReadRouteResponse>(response);
+    return response;
 }
 
-ResponseHolder RouteManager::ReadStop(string stop, int request_id) const {
+ReadStopResponse RouteManager::ReadStop(string stop, int request_id) const {
     ReadStopResponse response;
 
     response.request_id = request_id;
@@ -54,10 +528,11 @@ ResponseHolder RouteManager::ReadStop(string stop, int request_id) const {
     else{
         response.stats = nullopt;
     }
-    return make_unique<ReadStopResponse>(response);
+    return response;
 }
 
-ResponseHolder RouteManager::ReadRouteSearch(std::string from, std::string to, int request_id) const {
+ReadRouteSearchResponse RouteManager::ReadRouteSearch(std::string from, std::string to, int request_id,
+        size_t alternatives) const {
     ReadRouteSearchResponse response;
     // do smth;
     response.request_id = request_id;
@@ -68,33 +543,261 @@ ResponseHolder RouteManager::ReadRouteSearch(std::string from, std::string to, i
     size_t vertex_from = graphBuilder->name_to_stop_id_.at(from);
     size_t vertex_to = graphBuilder->name_to_stop_id_.at(to);
 
-    const auto route_info = graphBuilder->router.BuildRoute(vertex_from, vertex_to);
-    vector<RouteSearchStatsHolder> temp;
-    response.stats = move(temp);
-    //response.stats->reserve(route_info->edge_count);
-    
-    if (route_info) {
-        for (int i = 0 ;i < route_info->edge_count; ++i) {
-            int edge_id = graphBuilder->router.GetRouteEdge(route_info->id, i);
-            const auto& edge = graphBuilder->graph.GetEdge(edge_id);
-            if (edge.from % 2 == 0) {
-                string_view stop_name = graphBuilder->stop_id_to_name_[edge.from];
-                response.stats->push_back(make_unique<WaitRouteSearchStats>(stop_name, edge.weight));
-                response.total_time += edge.weight;
-            }
-            else {
-                string_view bus_name = graphBuilder->edge_id_to_route.at(edge_id);
-                int span_count = ComputeSpanCountOnEdge(bus_name, 
-                    graphBuilder->stop_id_to_name_, route_to_stops_, edge.from, edge.to);
-                response.stats->push_back(make_unique<BusRouteSearchStats>(bus_name, span_count, edge.weight));
-                response.total_time += edge.weight;
-            }
+    if (graphBuilder->settings.router == RouterMode::RAPTOR) {
+        // the last Pareto journey is the fastest
+        const auto journeys = graphBuilder->raptor->FindJourneys(vertex_from / 2, vertex_to / 2);
+        if (journeys.empty()) {
+            response.stats = nullopt;
+            return response;
         }
+        Itinerary fastest = MakeItinerary(journeys.back());
+        response.stats = move(fastest.items);
+        response.total_time = fastest.total_time;
+        return response;
+    }
+
+    if (alternatives > 0) {
+        // every itinerary comes from the same k-shortest search, whatever the router
+        const auto paths = graphBuilder->search.FindPaths(vertex_from, vertex_to, alternatives + 1);
+        METRICS_COUNT("search_settled_vertices", Graph::PathSearch<GraphWeight>::LastStats().settled_vertices);
+        METRICS_COUNT("search_relaxed_edges", Graph::PathSearch<GraphWeight>::LastStats().relaxed_edges);
+        if (paths.empty()) {
+            response.stats = nullopt;
+            return response;
+        }
+        Itinerary best = MakeItinerary(paths.front().edges);
+        response.stats = move(best.items);
+        response.total_time = best.total_time;
+        response.alternatives.reserve(paths.size() - 1);
+        for (size_t i = 1; i < paths.size(); ++i) {
+            response.alternatives.push_back(MakeItinerary(paths[i].edges));
+        }
+        return response;
+    }
+
+    const auto route = FindRoute(vertex_from, vertex_to);
+#if METRICS_ENABLED
+    const RouterMode router = graphBuilder->settings.router;
+    if (router != RouterMode::ALL_PAIRS && router != RouterMode::TREE_CACHE && router != RouterMode::HUB_LABELS
+            && router != RouterMode::CRP) {
+        const auto& search_stats = Graph::PathSearch<GraphWeight>::LastStats();
+        METRICS_COUNT("search_settled_vertices", search_stats.settled_vertices);
+        METRICS_COUNT("search_relaxed_edges", search_stats.relaxed_edges);
+    }
+#endif
+    if (route) {
+        Itinerary itinerary = MakeItinerary(route->edges);
+        response.stats = move(itinerary.items);
+        response.total_time = itinerary.total_time;
     }
     else {
         response.stats = nullopt;
     }
-    return make_unique<ReadRouteSearchResponse>(move(response));
+    return response;
+}
+
+vector<ReadRouteSearchResponse> RouteManager::ReadRouteSearches(const string& from,
+        const vector<pair<string, int>>& targets) const {
+    vector<ReadRouteSearchResponse> responses;
+    responses.reserve(targets.size());
+    // goal-directed routers may pick another of several equally fast
+    // paths than a full tree does, so they keep answering one by one
+    if (graphBuilder->settings.router != RouterMode::DIJKSTRA) {
+        for (const auto& [to, request_id] : targets) {
+            responses.push_back(ReadRouteSearch(from, to, request_id));
+        }
+        return responses;
+    }
+
+    vector<Graph::VertexId> vertices;
+    vertices.reserve(targets.size());
+    for (const auto& target : targets) {
+        vertices.push_back(graphBuilder->name_to_stop_id_.at(target.first));
+    }
+    const auto paths = graphBuilder->search.FindPathsTo(graphBuilder->name_to_stop_id_.at(from), vertices);
+    METRICS_COUNT("search_settled_vertices", Graph::PathSearch<GraphWeight>::LastStats().settled_vertices);
+    METRICS_COUNT("search_relaxed_edges", Graph::PathSearch<GraphWeight>::LastStats().relaxed_edges);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        ReadRouteSearchResponse& response = responses.emplace_back();
+        response.request_id = targets[i].second;
+        response.from = from;
+        response.to = targets[i].first;
+        response.total_time = 0;
+        if (paths[i]) {
+            Itinerary itinerary = MakeItinerary(paths[i]->edges);
+            response.stats = move(itinerary.items);
+            response.total_time = itinerary.total_time;
+        }
+        else {
+            response.stats = nullopt;
+        }
+    }
+    return responses;
+}
+
+ReadParetoRouteResponse RouteManager::ReadParetoRoute(string from, string to, int request_id) const {
+    ReadParetoRouteResponse response;
+    response.request_id = request_id;
+    response.from = from;
+    response.to = to;
+
+    const auto journeys = graphBuilder->raptor->FindJourneys(
+        graphBuilder->name_to_stop_id_.at(from) / 2, graphBuilder->name_to_stop_id_.at(to) / 2);
+    if (journeys.empty()) {
+        response.journeys = nullopt;
+        return response;
+    }
+    response.journeys.emplace();
+    response.journeys->reserve(journeys.size());
+    for (const auto& journey : journeys) {
+        response.journeys->push_back(MakeItinerary(journey));
+    }
+    return response;
+}
+
+ReadRouteSearchResponse RouteManager::ReadRouteSearchAt(string from, string to, int request_id,
+        double departure_time) const {
+    ReadRouteSearchResponse response;
+    response.request_id = request_id;
+    response.from = from;
+    response.to = to;
+    response.total_time = 0;
+
+    optional<Raptor::Journey> journey;
+    if (graphBuilder->timetable) {
+        journey = graphBuilder->timetable->FindJourney(graphBuilder->name_to_stop_id_.at(from) / 2,
+            graphBuilder->name_to_stop_id_.at(to) / 2, departure_time);
+    }
+    if (!journey) {
+        response.stats = nullopt;
+        return response;
+    }
+    Itinerary itinerary = MakeItinerary(*journey);
+    response.stats = move(itinerary.items);
+    response.total_time = itinerary.total_time;
+    return response;
+}
+
+ReadRouteSearchResponse RouteManager::ReadRouteSearchBetween(const Place& from, const Place& to,
+        int request_id) const {
+    const auto& builder = *graphBuilder;
+    auto name_of = [](const Place& place) {
+        const auto* name = get_if<string>(&place);
+        return name ? *name : string();
+    };
+    ReadRouteSearchResponse response;
+    response.request_id = request_id;
+    response.from = name_of(from);
+    response.to = name_of(to);
+    response.total_time = 0;
+
+    // a stop enters the graph at its own vertex, a point at those of its
+    // nearest stops after walking there
+    auto seeds = [&builder](const Place& place) {
+        vector<Graph::Seed<GraphWeight>> result;
+        if (const auto* name = get_if<string>(&place)) {
+            result.push_back({static_cast<Graph::VertexId>(builder.name_to_stop_id_.at(*name)), 0});
+        } else {
+            const auto nearest = builder.stop_index->FindNearest(get<Coordinate>(place),
+                builder.settings.access_stop_count);
+            for (const auto& [stop, meters] : nearest) {
+                result.push_back({2 * stop,
+                    GraphBuilder::ToWeight(meters / builder.settings.pedestrian_velocity, builder.settings)});
+            }
+        }
+        return result;
+    };
+    const auto route = builder.search.FindPath(seeds(from), seeds(to));
+    METRICS_COUNT("search_settled_vertices", Graph::PathSearch<GraphWeight>::LastStats().settled_vertices);
+    METRICS_COUNT("search_relaxed_edges", Graph::PathSearch<GraphWeight>::LastStats().relaxed_edges);
+
+    optional<Itinerary> transit;
+    if (route) {
+        // walks are timed from the coordinates, like the seeds were
+        auto walk = [&builder](const Place& place, Graph::VertexId vertex) {
+            return WalkRouteSearchStats{builder.stop_id_to_name_[vertex],
+                DistanceBetweenCoordinates(get<Coordinate>(place), builder.stop_coordinates[vertex / 2])
+                    / builder.settings.pedestrian_velocity};
+        };
+        Itinerary rides = MakeItinerary(route->path.edges);
+        transit.emplace();
+        transit->items.reserve(rides.items.size() + 2);
+        transit->total_time = 0;
+        if (holds_alternative<Coordinate>(from)) {
+            transit->items.push_back(walk(from, route->from));
+            transit->total_time += get<WalkRouteSearchStats>(transit->items.back()).time_;
+        }
+        move(begin(rides.items), end(rides.items), back_inserter(transit->items));
+        transit->total_time += rides.total_time;
+        if (holds_alternative<Coordinate>(to)) {
+            transit->items.push_back(walk(to, route->to));
+            transit->total_time += get<WalkRouteSearchStats>(transit->items.back()).time_;
+        }
+    }
+
+    if (holds_alternative<Coordinate>(from) && holds_alternative<Coordinate>(to)) {
+        const double direct = DistanceBetweenCoordinates(get<Coordinate>(from), get<Coordinate>(to))
+            / builder.settings.pedestrian_velocity;
+        if (!transit || direct <= transit->total_time) {
+            response.stats = vector<RouteSearchStats>{WalkRouteSearchStats{{}, direct}};
+            response.total_time = direct;
+            return response;
+        }
+    }
+    if (!transit) {
+        response.stats = nullopt;
+        return response;
+    }
+    response.stats = move(transit->items);
+    response.total_time = transit->total_time;
+    return response;
+}
+
+ReadNearestStopsResponse RouteManager::ReadNearestStops(Coordinate point, size_t count, int request_id) const {
+    ReadNearestStopsResponse response{request_id, {}};
+    for (const auto& [stop, meters] : graphBuilder->stop_index->FindNearest(point, count)) {
+        response.stops.emplace_back(graphBuilder->stop_id_to_name_[2 * stop], meters);
+    }
+    return response;
+}
+
+Graph::TreeCacheStats RouteManager::GetTreeCacheStats() const {
+    return graphBuilder->tree_cache ? graphBuilder->tree_cache->GetStats() : Graph::TreeCacheStats{};
+}
+
+Itinerary RouteManager::MakeItinerary(const Raptor::Journey& journey) const {
+    Itinerary itinerary{{}, journey.total_time};
+    itinerary.items.reserve(2 * journey.legs.size());
+    for (const auto& leg : journey.legs) {
+        itinerary.items.push_back(WaitRouteSearchStats{graphBuilder->stop_id_to_name_[2 * leg.from_stop], leg.wait_time});
+        itinerary.items.push_back(BusRouteSearchStats{leg.route, leg.span_count, leg.ride_time});
+    }
+    return itinerary;
+}
+
+Itinerary RouteManager::MakeItinerary(const vector<Graph::EdgeId>& edges) const {
+    const auto& settings = graphBuilder->settings;
+    Itinerary itinerary{{}, 0};
+    itinerary.items.reserve(edges.size());
+    for (const size_t edge_id : edges) {
+        const auto& edge = graphBuilder->graph.GetEdge(edge_id);
+        // the same floating-point times a ride distance over the velocity gives
+        double time;
+        if (edge.from % 2 == 0) {
+            string_view stop_name = graphBuilder->stop_id_to_name_[edge.from];
+            time = static_cast<double>(settings.bus_wait_time);
+            itinerary.items.push_back(WaitRouteSearchStats{stop_name, time});
+        }
+        else {
+            string_view bus_name = graphBuilder->edge_id_to_route.at(edge_id);
+            int span_count = ComputeSpanCountOnEdge(bus_name, 
+                graphBuilder->stop_id_to_name_, route_to_stops_, edge.from, edge.to);
+            time = static_cast<double>(edge.weight / GraphBuilder::UNITS_PER_METER) / settings.bus_velocity;
+            itinerary.items.push_back(BusRouteSearchStats{bus_name, span_count, time});
+        }
+        itinerary.total_time += time;
+    }
+    return itinerary;
 }
 
 
@@ -109,7 +812,10 @@ void RouteManager::AddStop(string stop, double lat, double lon, optional<DistInf
     }
 }
 void RouteManager::AddRoute(string route, vector<string> stops, 
-    bool is_roundtrip ){
+    bool is_roundtrip, vector<double> departures){
+    if (!departures.empty()) {
+        route_departures_[route] = move(departures);
+    }
     for (const auto& stop : stops){
         stop_to_routes_[stop].insert(route);
     }
@@ -2,13 +2,84 @@
 #include "response.h"
 #include "graph.h"
 #include "router.h"
+#include "path_search.h"
+#include "landmarks.h"
+#include "raptor.h"
+#include "timetable.h"
+#include "stop_index.h"
+#include "tree_cache.h"
+#include "hub_labels.h"
+#include "multilevel_overlay.h"
 
+#include <cmath>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <iomanip>
 #include <set>
+#include <variant>
+
+// How stops and routes are numbered in the graph. HASH keeps the iteration
+// order of the underlying hash maps; SPATIAL numbers stops along a Hilbert
+// curve over their coordinates and routes by name, which is reproducible
+// and keeps geographically close stops close in memory.
+enum class GraphLayout {
+    HASH,
+    SPATIAL
+};
+
+// How Route queries are answered. ALL_PAIRS precomputes every shortest path
+// up front; the others search per query: A_STAR is guided by the
+// great-circle distance to the target over the fastest possible ride, ALT
+// by distances to a few precomputed landmarks, and BIDIRECTIONAL runs
+// Dijkstra from both ends until the frontiers meet. RAPTOR scans the stop
+// sequences of the routes and builds no ride edges at all; without them,
+// Route requests get no alternatives and coordinate ends only walk.
+// TREE_CACHE computes the full shortest path tree of a source stop the
+// first time it is queried and keeps the recently used ones, so it answers
+// as DIJKSTRA does without searching again for hot sources. HUB_LABELS
+// precomputes a hub label index and answers by merging two labels. CRP
+// partitions the stops into nested cells once and customizes shortcuts
+// across each cell for the settings, so UpdateRoutingSettings only redoes
+// the customization.
+enum class RouterMode {
+    ALL_PAIRS,
+    DIJKSTRA,
+    A_STAR,
+    ALT,
+    BIDIRECTIONAL,
+    RAPTOR,
+    TREE_CACHE,
+    HUB_LABELS,
+    CRP
+};
+
+struct RoutingSettings {
+    int bus_wait_time;
+    // meters per minute
+    double bus_velocity;
+    // threads used to build the graph edges, 0 means all hardware threads
+    size_t build_threads = 0;
+    GraphLayout layout = GraphLayout::HASH;
+    RouterMode router = RouterMode::ALL_PAIRS;
+    size_t landmark_count = 8;
+    // meters per minute on foot, between a coordinate end of a route and a stop
+    double pedestrian_velocity = 5.0 * 1000 / 60;
+    // nearest stops a coordinate end of a route may walk to
+    size_t access_stop_count = 8;
+    // memory for the trees of the TREE_CACHE router
+    size_t tree_cache_bytes = size_t{256} << 20;
+    // keep only the lightest of parallel edges
+    bool merge_parallel_edges = true;
+    // drop rides that getting off and on again within the route beats
+    bool prune_dominated_edges = false;
+};
+
+// an end of a Route request: a stop by name, or a point to walk from or to
+using Place = std::variant<std::string, Coordinate>;
 
 class RouteManager{
 public:
@@ -19,14 +90,50 @@ public:
     using StopPair = std::pair<std::string, std::string>;
     using RoutesData = std::unordered_map<std::string, RouteInfo>;
     using StopsData = std::unordered_map<std::string, Coordinate>;
+    // fixed-point weight of the graph edges, see GraphBuilder
+    using GraphWeight = int64_t;
 
-    ResponseHolder ReadRoute(std::string route, int request_id) const;
-    ResponseHolder ReadStop(std::string stop, int request_id) const;
-    ResponseHolder ReadRouteSearch(std::string from, std::string to, int request_id) const;
+    ReadRouteResponse ReadRoute(std::string route, int request_id) const;
+    ReadStopResponse ReadStop(std::string stop, int request_id) const;
+    // the fastest itinerary, followed by up to `alternatives` next fastest
+    // loopless ones when asked for
+    ReadRouteSearchResponse ReadRouteSearch(std::string from, std::string to, int request_id,
+            size_t alternatives = 0) const;
+    // Route answers from one stop to many, each as ReadRouteSearch gives
+    // it; with the DIJKSTRA router a single search serves them all
+    std::vector<ReadRouteSearchResponse> ReadRouteSearches(const std::string& from,
+            const std::vector<std::pair<std::string, int>>& targets) const;
+    // every journey that no other beats on both arrival time and transfers
+    ReadParetoRouteResponse ReadParetoRoute(std::string from, std::string to, int request_id) const;
+    // the earliest arrival when leaving at departure_time (minutes since
+    // midnight) on the routes that have departures
+    ReadRouteSearchResponse ReadRouteSearchAt(std::string from, std::string to, int request_id,
+            double departure_time) const;
+    // the fastest itinerary when either end may be a point: one search
+    // from all the stops near the start to all those near the end, or a
+    // walk straight there when that is faster
+    ReadRouteSearchResponse ReadRouteSearchBetween(const Place& from, const Place& to, int request_id) const;
+    // the stops closest to a point, nearest first
+    ReadNearestStopsResponse ReadNearestStops(Coordinate point, size_t count, int request_id) const;
+    // lookups of the TREE_CACHE router so far, all zero with other routers
+    Graph::TreeCacheStats GetTreeCacheStats() const;
 
     void AddStop(std::string stop, double lat, double lon, std::optional<DistInfo> other_stops);
-    void AddRoute(std::string route, std::vector<std::string> stops, bool is_roundtrip);
-    void RunGraphBuilder(std::pair<int, double> routing_settings);
+    // departures are minutes since midnight at the first stop; a trip rides
+    // the whole route (there and back unless it is a roundtrip)
+    void AddRoute(std::string route, std::vector<std::string> stops, bool is_roundtrip,
+            std::vector<double> departures = {});
+    // builds the graph and precomputes the router
+    void RunGraphBuilder(const RoutingSettings& routing_settings);
+    // the two phases of RunGraphBuilder, exposed separately for benchmarks
+    size_t BuildGraph(const RoutingSettings& routing_settings);
+    void PrecomputeRouter();
+    // switches to new settings; with the CRP router before and after, and
+    // only the wait time or the velocity changed, reweights the graph and
+    // customizes the overlay instead of building everything again
+    void UpdateRoutingSettings(const RoutingSettings& routing_settings);
+    // the graph BuildGraph made, for benchmarks of the search indexes
+    const Graph::DirectedWeightedGraph<GraphWeight>& GetGraph() const;
 
 private:
     
@@ -44,35 +151,66 @@ private:
     std::unordered_map<std::string, Coordinate> stops_;
     std::unordered_map<std::string, RouteInfo> route_to_stops_;
     std::unordered_map<std::string, StopInfo> stop_to_routes_;
-    std::unordered_map<StopPair, int, StopsHasher > distances_;
+    std::unordered_map<std::string, std::vector<double>> route_departures_;
     using Distances = std::unordered_map<StopPair, int, StopsHasher>;
+    Distances distances_;
 
     class GraphBuilder {
-        using WeightType = double;
+        using WeightType = GraphWeight;
         using Router = Graph::Router<WeightType>;
     public:
-        GraphBuilder(const RouteManager * manager, const std::pair<int, double> setInfo) : 
+        // Edge weights are integers: a unit is the time a bus takes for
+        // 1/60 m, so a minute is bus_velocity * 60 units (the velocity in
+        // meters per hour). A ride weighs exactly its road meters times 60,
+        // and a wait is exact whenever bus_velocity in km/h has at most
+        // three decimals. Response times are computed from the distances.
+        static constexpr WeightType UNITS_PER_METER = 60;
+        static WeightType ToWeight(double minutes, const RoutingSettings& settings) {
+            return std::llround(minutes * settings.bus_velocity * UNITS_PER_METER);
+        }
+        // the stops in the order the layout numbers them
+        static std::vector<const std::string*> OrderStops(const StopsData& stops, GraphLayout layout);
+
+        GraphBuilder(const RouteManager * manager, const RoutingSettings& settings) : 
                 graph(2 * manager->stops_.size()),
-                stop_id_to_name_(InitStopIdToNameMaps(manager->stops_)),
+                stop_id_to_name_(InitStopIdToNameMaps(manager->stops_, settings.layout)),
                 name_to_stop_id_(InitNameToStopIdMaps(manager->stops_, this)),
-                edge_id_to_route(InitEdgeIdToRouteName(manager, setInfo)),
-                router(graph) {}
+                edge_id_to_route(InitEdgeIdToRouteName(manager, settings)),
+                settings(settings),
+                search(graph) {}
 
-        Graph::DirectedWeightedGraph<double> graph;
+        using Path = Graph::Path<WeightType>;
+
+        Graph::DirectedWeightedGraph<WeightType> graph;
         const std::vector<std::string> stop_id_to_name_;
         const std::unordered_map<std::string, int> name_to_stop_id_;
-        const std::unordered_map<int, std::string> edge_id_to_route;
-        Router router;
+        const std::vector<std::string_view> edge_id_to_route;
+        RoutingSettings settings;
+        std::optional<Router> router;
+        Graph::PathSearch<WeightType> search;
+
+        // coordinates of every stop (vertex / 2), indexed for nearest-stop
+        // lookups, and for A* the least possible ride weight per meter of
+        // great-circle distance
+        std::vector<Coordinate> stop_coordinates;
+        std::optional<StopIndex> stop_index;
+        double min_weight_per_meter = 0;
+        std::optional<Graph::LandmarkIndex<WeightType>> landmarks;
+        std::optional<Graph::TreeCache<WeightType>> tree_cache;
+        std::optional<Graph::HubLabels<WeightType>> hub_labels;
+        std::optional<Graph::MultilevelOverlay<WeightType>> overlay;
+        std::optional<Raptor> raptor;
+        std::optional<Timetable> timetable;
 
     private:
         static std::vector<std::string> 
-        InitStopIdToNameMaps(const StopsData& stops_){
+        InitStopIdToNameMaps(const StopsData& stops_, GraphLayout layout){
             std::vector<std::string> result;
             result.resize(stops_.size() * 2);
             int i = 0;
-            for (const auto& [stop_name, coord] : stops_) {
-                result[i] = stop_name;
-                result[i + 1] = stop_name;
+            for (const std::string* stop_name : OrderStops(stops_, layout)) {
+                result[i] = *stop_name;
+                result[i + 1] = *stop_name;
                 i += 2;
             }
             return result;
@@ -87,66 +225,40 @@ private:
             }
             return result;
         }
-        
-        std::unordered_map<int, std::string>
-        InitEdgeIdToRouteName(const RouteManager * manager, const std::pair<int, double> setInfo) {
-            std::unordered_map<int, std::string> result;
-
-            for (const auto& [route_name, route_stops] : manager->route_to_stops_) {
-                const auto& stops = route_stops.first;
-                // build edges for roundtrip route
-                if (route_stops.second){
-                    for (int i = 0; i < stops.size(); ++i) {
-                        unsigned long stop_id_from = name_to_stop_id_.at(stops[i]) + 1;
-                        
-                        size_t edge_id = graph.AddEdge({stop_id_from - 1, stop_id_from, static_cast<double>(setInfo.first)});
-                        result.emplace(edge_id, route_name);
-
-                        for (int j = i ; j < stops.size(); ++j) {
-                            unsigned long  stop_id_to = name_to_stop_id_.at(stops[j]);
-                            int dist = RouteManager::ComputeRealDistForTwoVertices(stops, manager->distances_, i, j);
-                            size_t edge_id = graph.AddEdge({stop_id_from, stop_id_to, dist / setInfo.second});
-                            result.emplace(edge_id, route_name);
-                        }
-                    }
-                }
-                // build edges for ordinary route
-                else {
-                    int n = stops.size();
-                    for (int i = 0; i < n; ++i) {
-                        unsigned long  stop_id_from = name_to_stop_id_.at(stops[i]) + 1;
-                        
-                        size_t edge_id = graph.AddEdge({stop_id_from - 1, stop_id_from, static_cast<double>(setInfo.first)});
-                        result.emplace(edge_id, route_name);
-
-                        for (int j = i + 1; j < n; ++j) {
-                            unsigned long  stop_id_to = name_to_stop_id_.at(stops[j]);
-                            int dist = RouteManager::ComputeRealDistForTwoVertices(stops, manager->distances_, i, j);
-                            size_t edge_id = graph.AddEdge({stop_id_from, stop_id_to, dist / setInfo.second});
-                            result.emplace(edge_id, route_name);    
-                        }
-                    }
-                    for (int i = n - 1; i >= 0; i--) {
-                        unsigned long stop_id_from = name_to_stop_id_.at(stops[i]) + 1;
-
-                        for (int j = i - 1; j >= 0; j--) {
-                            unsigned long  stop_id_to = name_to_stop_id_.at(stops[j]);
-                            int dist = RouteManager::ComputeRealDistForTwoVertices(stops, manager->distances_, i, j);
-                            size_t edge_id = graph.AddEdge({stop_id_from, stop_id_to, dist / setInfo.second});
-                            result.emplace(edge_id, route_name);  
-                        }
-                    }
-                }
-            }
-            return result;
-        }
+
+        // Edges are built in two passes: the edge count of every route is known
+        // up front, so each route gets its own slice of the edge array and the
+        // routes are filled in parallel. Edge ids depend only on the route order.
+        std::vector<std::string_view>
+        InitEdgeIdToRouteName(const RouteManager * manager, const RoutingSettings& settings);
+
+        static size_t CountRouteEdges(const RouteInfo& route);
+        void FillRouteEdges(const RoutesData::value_type& route, const Distances& distances,
+                const RoutingSettings& settings, size_t first_edge_id,
+                std::vector<Graph::Edge<WeightType>>& edges,
+                std::vector<std::string_view>& edge_routes,
+                std::vector<char>& dominated) const;
     };
     std::optional<GraphBuilder> graphBuilder = std::nullopt;
 
+    void InitStopIndex();
+    void InitGeoBound();
+    void InitRaptor();
+    void InitTimetable();
+    void InitOverlay();
+    std::optional<GraphBuilder::Path> FindRoute(size_t vertex_from, size_t vertex_to) const;
+    // the legs of a path, named after the stops and routes of its edges
+    Itinerary MakeItinerary(const std::vector<Graph::EdgeId>& edges) const;
+    Itinerary MakeItinerary(const Raptor::Journey& journey) const;
+
     double ComputeRouteGeoDistance(const std::vector<std::string>& stops, 
             bool is_roundtrip) const;
     int ComputeRouteRealDistance(const std::vector<std::string>& stops,
             bool is_roundtrip) const;
+    // road distances from the first stop to every stop, along the route
+    // and (for the way back) against it
+    static void AccumulateDistances(const std::vector<std::string>& stops, const Distances& distances,
+            std::vector<int>& forward, std::vector<int>& backward);
 public:
     static int ComputeRealDistForTwoVertices(const std::vector<std::string>& stops, 
             const Distances& distances, const int stop_a , int stop_b);
@@ -6,6 +6,7 @@
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
 #include <utility>
@@ -31,7 +32,7 @@ namespace Graph {
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
     EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
-    void ReleaseRoute(RouteId route_id);
+    void ReleaseRoute(RouteId route_id) const;
 
   private:
     const Graph& graph_;
@@ -43,6 +44,8 @@ namespace Graph {
     using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
 
     using ExpandedRoute = std::vector<EdgeId>;
+    // guards the expanded routes cache, queries may come from several threads
+    mutable std::mutex cache_mutex_;
     mutable RouteId next_route_id_ = 0;
     mutable std::unordered_map<RouteId, ExpandedRoute> expanded_routes_cache_;
 
@@ -119,19 +122,22 @@ namespace Graph {
     }
     std::reverse(std::begin(edges), std::end(edges));
 
-    const RouteId route_id = next_route_id_++;
     const size_t route_edge_count = edges.size();
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    const RouteId route_id = next_route_id_++;
     expanded_routes_cache_[route_id] = std::move(edges);
     return RouteInfo{route_id, weight, route_edge_count};
   }
 
   template <typename Weight>
   EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
     return expanded_routes_cache_.at(route_id)[edge_idx];
   }
 
   template <typename Weight>
-  void Router<Weight>::ReleaseRoute(RouteId route_id) {
+  void Router<Weight>::ReleaseRoute(RouteId route_id) const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
     expanded_routes_cache_.erase(route_id);
   }
 
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // Min-queue of (key, value) for shortest-path searches. A radix heap for
+  // integer keys: the keys of a Dijkstra or consistent A* search never drop
+  // below the last one popped, so an item only goes into the bucket of the
+  // highest bit in which its key differs from that one, and moves to lower
+  // buckets at most once per bit. Keys are non-negative. A key below the
+  // last popped one (a slightly inconsistent potential) is raised to it,
+  // which keeps a search with reopening exact. Floating keys fall back to a
+  // binary heap.
+  template <typename Key, typename Value, bool = std::is_integral_v<Key>>
+  class SearchQueue {
+  public:
+    bool empty() const {
+      return size_ == 0;
+    }
+
+    void clear() {
+      for (auto& bucket : buckets_) {
+        bucket.clear();
+      }
+      size_ = 0;
+      last_ = 0;
+    }
+
+    void push(Key key, Value value) {
+      const UnsignedKey bits = std::max(static_cast<UnsignedKey>(key), last_);
+      buckets_[BucketOf(bits)].push_back({bits, std::move(value)});
+      ++size_;
+    }
+
+    // removes an item with the smallest key
+    std::pair<Key, Value> pop() {
+      if (buckets_[0].empty()) {
+        size_t index = 1;
+        while (buckets_[index].empty()) {
+          ++index;
+        }
+        // the smallest key of the first non-empty bucket becomes the
+        // reference, and every item of that bucket lands in a lower one
+        auto& bucket = buckets_[index];
+        last_ = std::min_element(bucket.begin(), bucket.end(), [](const Entry& lhs, const Entry& rhs) {
+          return lhs.first < rhs.first;
+        })->first;
+        for (Entry& entry : bucket) {
+          buckets_[BucketOf(entry.first)].push_back(std::move(entry));
+        }
+        bucket.clear();
+      }
+      Entry entry = std::move(buckets_[0].back());
+      buckets_[0].pop_back();
+      --size_;
+      return {static_cast<Key>(entry.first), std::move(entry.second)};
+    }
+
+  private:
+    using UnsignedKey = std::make_unsigned_t<Key>;
+    using Entry = std::pair<UnsignedKey, Value>;
+    size_t BucketOf(UnsignedKey key) const {
+      const UnsignedKey diff = key ^ last_;
+      if (diff == 0) {
+        return 0;
+      }
+      return sizeof(unsigned long long) * 8 - __builtin_clzll(static_cast<unsigned long long>(diff));
+    }
+
+    std::array<std::vector<Entry>, sizeof(Key) * 8 + 1> buckets_;
+    size_t size_ = 0;
+    UnsignedKey last_ = 0;
+  };
+
+  template <typename Key, typename Value>
+  class SearchQueue<Key, Value, false> {
+  public:
+    bool empty() const {
+      return heap_.empty();
+    }
+
+    void clear() {
+      heap_.clear();
+    }
+
+    void push(Key key, Value value) {
+      heap_.emplace_back(key, std::move(value));
+      std::push_heap(heap_.begin(), heap_.end(), Later);
+    }
+
+    std::pair<Key, Value> pop() {
+      std::pop_heap(heap_.begin(), heap_.end(), Later);
+      std::pair<Key, Value> entry = std::move(heap_.back());
+      heap_.pop_back();
+      return entry;
+    }
+
+  private:
+    static bool Later(const std::pair<Key, Value>& lhs, const std::pair<Key, Value>& rhs) {
+      return lhs.first > rhs.first;
+    }
+
+    std::vector<std::pair<Key, Value>> heap_;
+  };
+
+}
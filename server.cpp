@@ -0,0 +1,296 @@
+#include "server.h"
+#include "json.h"
+#include "request.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+RequestServer::RequestServer(const SnapshotStore& store, ServerOptions options)
+    : store_(store), options_(move(options)) {
+    if (pipe(wake_pipe_) != 0) {
+        throw runtime_error("cannot create wake pipe");
+    }
+    SetNonBlocking(wake_pipe_[0]);
+    SetNonBlocking(wake_pipe_[1]);
+
+    if (options_.socket_path.empty()) {
+        connections_.emplace_back(next_connection_id_++, STDIN_FILENO, STDOUT_FILENO);
+        return;
+    }
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listen_fd_ < 0 || options_.socket_path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("cannot create socket " + options_.socket_path);
+    }
+    copy(options_.socket_path.begin(), options_.socket_path.end(), address.sun_path);
+    unlink(options_.socket_path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listen_fd_, 64) != 0) {
+        throw runtime_error("cannot listen on " + options_.socket_path);
+    }
+    SetNonBlocking(listen_fd_);
+}
+
+RequestServer::~RequestServer() {
+    for (const auto& connection : connections_) {
+        if (connection.input_fd != STDIN_FILENO) {
+            close(connection.input_fd);
+        }
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(options_.socket_path.c_str());
+    }
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+}
+
+string RequestServer::ProcessLine(const RouteManager& manager, const string& line) {
+    METRICS_SCOPE("server_line");
+    ostringstream output;
+    // set once the line parsed far enough to have one, for the error answer
+    optional<string> request_id;
+    try {
+        const Json::Document document = Json::Load(line);
+        const auto& map = document.GetRoot().AsMap();
+        if (const auto it = map.find("id"); it != map.end() && it->second.IsDouble()) {
+            request_id = to_string(static_cast<int>(it->second.AsDouble()));
+        }
+        const auto request = ParseRequest<StatRequests>(map);
+        if (!request) {
+            throw invalid_argument("unknown request type");
+        }
+        PrintResponse(ProcessRequest(*request, manager), output);
+    } catch (const exception& e) {
+        string message = e.what();
+        replace(message.begin(), message.end(), '"', '\'');
+        return "{" + (request_id ? "\"request_id\": " + *request_id + ", " : string())
+            + "\"error_message\": \"" + message + "\"}";
+    }
+    // the array layout puts every field on its own tab-indented line
+    string response = output.str();
+    response.erase(remove_if(response.begin(), response.end(), [](char c) {
+        return c == '\n' || c == '\t';
+    }), response.end());
+    return response;
+}
+
+void RequestServer::Stop() {
+    stop_requested_ = true;
+    Wake();
+}
+
+void RequestServer::Wake() {
+    const char byte = 0;
+    // a full pipe already guarantees a wake-up
+    [[maybe_unused]] auto written = write(wake_pipe_[1], &byte, 1);
+}
+
+void RequestServer::WorkerLoop() {
+    for (;;) {
+        Job job;
+        {
+            unique_lock<mutex> lock(jobs_mutex_);
+            jobs_ready_.wait(lock, [this] { return shutting_down_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+            job = move(jobs_.front());
+            jobs_.pop_front();
+        }
+        string response = ProcessLine(store_.Get()->manager, job.line);
+        {
+            lock_guard<mutex> lock(results_mutex_);
+            results_.push_back({job.connection_id, move(response)});
+        }
+        Wake();
+    }
+}
+
+bool RequestServer::ReadFrom(Connection& connection) {
+    char buffer[1 << 16];
+    const ssize_t size = read(connection.input_fd, buffer, sizeof(buffer));
+    if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR)) {
+        connection.input_closed = true;
+        // the last request may lack its newline
+        if (!connection.input_buffer.empty() && connection.input_buffer.back() != '\n') {
+            connection.input_buffer += '\n';
+        }
+        return false;
+    }
+    if (size > 0) {
+        connection.input_buffer.append(buffer, size);
+    }
+    return true;
+}
+
+bool RequestServer::WriteTo(Connection& connection) {
+    // a socket whose peer is gone fails with EPIPE instead of raising
+    // SIGPIPE; stdout relies on Serve ignoring the signal
+    const ssize_t size = connection.output_fd == STDOUT_FILENO
+        ? write(connection.output_fd, connection.output_buffer.data(), connection.output_buffer.size())
+        : send(connection.output_fd, connection.output_buffer.data(), connection.output_buffer.size(), MSG_NOSIGNAL);
+    if (size < 0) {
+        // EPIPE, ECONNRESET and the like close this connection only
+        return errno == EAGAIN || errno == EINTR;
+    }
+    connection.output_buffer.erase(0, size);
+    return true;
+}
+
+void RequestServer::CollectResults() {
+    vector<Result> results;
+    {
+        lock_guard<mutex> lock(results_mutex_);
+        results.swap(results_);
+    }
+    for (auto& result : results) {
+        --in_flight_;
+        const auto it = find_if(connections_.begin(), connections_.end(), [&](const Connection& connection) {
+            return connection.id == result.connection_id;
+        });
+        // the client may have gone away in the meantime
+        if (it != connections_.end()) {
+            --it->in_flight;
+            if (!it->output_closed) {
+                it->output_buffer += result.response;
+                it->output_buffer += '\n';
+            }
+        }
+    }
+}
+
+void RequestServer::Run() {
+    vector<thread> workers;
+    for (size_t i = 0; i < max<size_t>(1, options_.worker_count); ++i) {
+        workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    // hands buffered complete lines to the workers while the queue has room
+    auto dispatch = [this](Connection& connection) {
+        if (connection.output_closed) {
+            connection.input_buffer.clear();
+            return;
+        }
+        size_t line_start = 0;
+        vector<Job> jobs;
+        while (in_flight_ < options_.queue_capacity) {
+            const size_t line_end = connection.input_buffer.find('\n', line_start);
+            if (line_end == string::npos) {
+                break;
+            }
+            string line = connection.input_buffer.substr(line_start, line_end - line_start);
+            line_start = line_end + 1;
+            if (line.find_first_not_of(" \t\r") == string::npos) {
+                continue;
+            }
+            jobs.push_back({connection.id, move(line)});
+            ++in_flight_;
+            ++connection.in_flight;
+        }
+        connection.input_buffer.erase(0, line_start);
+        if (!jobs.empty()) {
+            lock_guard<mutex> lock(jobs_mutex_);
+            move(jobs.begin(), jobs.end(), back_inserter(jobs_));
+        }
+        jobs_ready_.notify_all();
+    };
+
+    vector<pollfd> poll_fds;
+    while (!stop_requested_) {
+        CollectResults();
+        for (auto& connection : connections_) {
+            dispatch(connection);
+        }
+        // connections that sent everything and got every answer are done
+        connections_.erase(remove_if(connections_.begin(), connections_.end(), [&](const Connection& connection) {
+            const bool done = connection.input_closed && connection.in_flight == 0
+                && connection.output_buffer.empty()
+                && connection.input_buffer.find('\n') == string::npos;
+            if (done && connection.input_fd != STDIN_FILENO) {
+                close(connection.input_fd);
+            }
+            return done;
+        }), connections_.end());
+        if (listen_fd_ < 0 && connections_.empty()) {
+            break;
+        }
+
+        const bool has_room = in_flight_ < options_.queue_capacity;
+        poll_fds.clear();
+        poll_fds.push_back({wake_pipe_[0], POLLIN, 0});
+        if (listen_fd_ >= 0) {
+            poll_fds.push_back({has_room ? listen_fd_ : -1, POLLIN, 0});
+        }
+        for (const auto& connection : connections_) {
+            const bool readable = has_room && !connection.input_closed
+                && connection.output_buffer.size() < options_.max_pending_output;
+            // negative descriptors are skipped by poll, so a hung-up input
+            // that we do not want to read cannot spin the loop
+            poll_fds.push_back({readable ? connection.input_fd : -1, POLLIN, 0});
+            poll_fds.push_back({connection.output_buffer.empty() ? -1 : connection.output_fd, POLLOUT, 0});
+        }
+        if (poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        char drain[256];
+        while (read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+        }
+        size_t index = 1;
+        if (listen_fd_ >= 0) {
+            if (poll_fds[index++].revents & POLLIN) {
+                for (int client; (client = accept(listen_fd_, nullptr, nullptr)) >= 0; ) {
+                    SetNonBlocking(client);
+                    connections_.emplace_back(next_connection_id_++, client, client);
+                }
+            }
+        }
+        // poll_fds holds two entries per connection in connection order;
+        // accepted clients were appended after them
+        const size_t polled = (poll_fds.size() - index) / 2;
+        for (size_t i = 0; i < polled; ++i, index += 2) {
+            Connection& connection = connections_[i];
+            if (poll_fds[index].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ReadFrom(connection);
+            }
+            if ((poll_fds[index + 1].revents & POLLOUT) && !WriteTo(connection)) {
+                // the peer is gone: drop whatever is still to be sent
+                connection.output_buffer.clear();
+                connection.input_closed = true;
+                connection.output_closed = true;
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(jobs_mutex_);
+        shutting_down_ = true;
+        jobs_.clear();
+    }
+    jobs_ready_.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
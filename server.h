@@ -0,0 +1,89 @@
+#pragma once
+#include "route_manager.h"
+#include "snapshot_store.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ServerOptions {
+    // listen on this Unix socket; empty means serve stdin/stdout
+    std::string socket_path;
+    size_t worker_count = 1;
+    // requests parsed but not yet answered; reading stops while it is full
+    size_t queue_capacity = 1024;
+    // unsent response bytes per connection before reading from it pauses
+    size_t max_pending_output = 1 << 20;
+};
+
+// Resident server for stat requests. A single poll() loop reads newline-
+// delimited JSON requests from stdin or from clients of a Unix socket and
+// hands them to worker threads through a bounded queue. Each response is
+// written back as one line as soon as it is ready, so responses to one
+// connection may come back out of order; request_id tells them apart.
+// Every request is answered from the snapshot current when a worker takes
+// it up, so the network may be rebuilt while the server runs.
+class RequestServer {
+public:
+    RequestServer(const SnapshotStore& store, ServerOptions options);
+    ~RequestServer();
+
+    // serves until the input is exhausted (stdin) or Stop() is called (socket)
+    void Run();
+    // may be called from any thread
+    void Stop();
+
+    // one stat request line in, one response line out
+    static std::string ProcessLine(const RouteManager& manager, const std::string& line);
+
+private:
+    struct Job {
+        size_t connection_id;
+        std::string line;
+    };
+    struct Result {
+        size_t connection_id;
+        std::string response;
+    };
+    struct Connection {
+        Connection(size_t id, int input_fd, int output_fd)
+            : id(id), input_fd(input_fd), output_fd(output_fd) {}
+
+        size_t id;
+        int input_fd;
+        int output_fd;
+        std::string input_buffer;
+        std::string output_buffer;
+        size_t in_flight = 0;
+        bool input_closed = false;
+        // the peer stopped reading; answers still due are dropped
+        bool output_closed = false;
+    };
+
+    void WorkerLoop();
+    void Wake();
+    bool ReadFrom(Connection& connection);
+    bool WriteTo(Connection& connection);
+    void CollectResults();
+
+    const SnapshotStore& store_;
+    const ServerOptions options_;
+
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_ready_;
+    std::deque<Job> jobs_;
+    bool shutting_down_ = false;
+
+    std::mutex results_mutex_;
+    std::vector<Result> results_;
+
+    std::vector<Connection> connections_;
+    size_t next_connection_id_ = 0;
+    size_t in_flight_ = 0;
+    int listen_fd_ = -1;
+    int wake_pipe_[2] = {-1, -1};
+    std::atomic<bool> stop_requested_ = false;
+};
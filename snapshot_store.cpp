@@ -0,0 +1,125 @@
+#include "snapshot_store.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// nice value of the builder thread, above the default of 0
+static constexpr int BUILDER_NICE = 10;
+
+SnapshotStore::SnapshotStore(const vector<BaseRequest>& base_requests, const RoutingSettings& settings)
+    : current_(Build({base_requests, settings}, 1)) {
+    builder_ = thread([this] { BuilderLoop(); });
+}
+
+SnapshotStore::~SnapshotStore() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    builder_.join();
+}
+
+SnapshotStore::Snapshot SnapshotStore::Build(const Job& job, uint64_t version) {
+    METRICS_SCOPE("snapshot_build");
+    auto snapshot = make_shared<NetworkSnapshot>();
+    snapshot->version = version;
+    ProcessRequests(job.base_requests, snapshot->manager);
+    snapshot->manager.RunGraphBuilder(job.settings);
+    return snapshot;
+}
+
+SnapshotStore::Snapshot SnapshotStore::Get() const {
+    return atomic_load(&current_);
+}
+
+void SnapshotStore::Rebuild(vector<BaseRequest> base_requests, RoutingSettings settings) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        pending_ = Job{move(base_requests), move(settings)};
+    }
+    changed_.notify_all();
+}
+
+uint64_t SnapshotStore::Wait() {
+    unique_lock<mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !pending_ && !building_; });
+    if (error_) {
+        rethrow_exception(exchange(error_, nullptr));
+    }
+    return Get()->version;
+}
+
+size_t SnapshotStore::GetRetiredCount() const {
+    lock_guard<mutex> lock(mutex_);
+    return retired_.size();
+}
+
+void SnapshotStore::Reclaim() {
+    // once replaced, a snapshot gains no readers: a use count of one is ours
+    vector<Snapshot> unused;
+    {
+        lock_guard<mutex> lock(mutex_);
+        const auto it = partition(retired_.begin(), retired_.end(), [](const Snapshot& snapshot) {
+            return snapshot.use_count() > 1;
+        });
+        move(it, retired_.end(), back_inserter(unused));
+        retired_.erase(it, retired_.end());
+    }
+    // destroyed here, outside the lock
+}
+
+void SnapshotStore::BuilderLoop() {
+    // readers come first where cores are short; the threads a build
+    // starts inherit the priority
+    [[maybe_unused]] const int niced = setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), BUILDER_NICE);
+    uint64_t version = Get()->version;
+    for (;;) {
+        Job job;
+        {
+            unique_lock<mutex> lock(mutex_);
+            // wake up now and then to free what readers let go of
+            changed_.wait_for(lock, chrono::milliseconds(20), [this] { return stopping_ || pending_; });
+            if (stopping_) {
+                return;
+            }
+            if (!pending_) {
+                lock.unlock();
+                Reclaim();
+                continue;
+            }
+            job = move(*pending_);
+            pending_.reset();
+            building_ = true;
+        }
+
+        Snapshot snapshot;
+        exception_ptr error;
+        try {
+            snapshot = Build(job, version + 1);
+        } catch (...) {
+            error = current_exception();
+        }
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (snapshot) {
+                ++version;
+                retired_.push_back(atomic_exchange(&current_, move(snapshot)));
+                METRICS_COUNT("snapshot_published", 1);
+            } else {
+                error_ = error;
+            }
+            building_ = false;
+        }
+        changed_.notify_all();
+        Reclaim();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "request.h"
+#include "route_manager.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// A network with its graph and router fully built, never changed again.
+struct NetworkSnapshot {
+    uint64_t version = 0;
+    RouteManager manager;
+};
+
+// Holds the current network snapshot for concurrent readers. A reader
+// takes the snapshot with one atomic shared_ptr load and keeps answering
+// from it however long it runs. Rebuilds run on a builder thread of their
+// own and publish the new snapshot with an atomic exchange; rebuilds
+// requested while one is running collapse into the latest. Replaced
+// snapshots are kept until no reader holds them and then freed by the
+// builder thread, so a query never pays for tearing a network down.
+class SnapshotStore {
+public:
+    using Snapshot = std::shared_ptr<const NetworkSnapshot>;
+
+    // builds the first snapshot on the calling thread
+    SnapshotStore(const std::vector<BaseRequest>& base_requests, const RoutingSettings& settings);
+    ~SnapshotStore();
+
+    // may be called from any thread
+    Snapshot Get() const;
+    // queues a rebuild from new base data and returns at once
+    void Rebuild(std::vector<BaseRequest> base_requests, RoutingSettings settings);
+    // waits until every queued rebuild is published and returns the
+    // current version; rethrows what the last failed rebuild threw
+    uint64_t Wait();
+    // replaced snapshots some reader still holds
+    size_t GetRetiredCount() const;
+
+private:
+    struct Job {
+        std::vector<BaseRequest> base_requests;
+        RoutingSettings settings;
+    };
+
+    static Snapshot Build(const Job& job, uint64_t version);
+    void BuilderLoop();
+    // frees the retired snapshots no reader holds any more
+    void Reclaim();
+
+    // read and replaced with the std::atomic_* functions for shared_ptr only
+    Snapshot current_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::optional<Job> pending_;
+    bool building_ = false;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::vector<Snapshot> retired_;
+    std::thread builder_;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded queue between exactly one producer thread and one consumer
+// thread. Each side advances only its own index and reads the other's, so
+// a push or a pop takes no lock unless the other side sleeps. Push and Pop
+// wait for room or an item by spinning a little, then yielding, then
+// sleeping until the other side moves.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t capacity) : slots_(capacity + 1) {}
+
+  // moves from value only when there was room
+  bool TryPush(T& value) {
+    if (!Put(value)) {
+      return false;
+    }
+    Wake();
+    return true;
+  }
+
+  bool TryPop(T& value) {
+    if (!Take(value)) {
+      return false;
+    }
+    Wake();
+    return true;
+  }
+
+  void Push(T value) {
+    Wait([&] { return Put(value); });
+    Wake();
+  }
+
+  T Pop() {
+    T value;
+    Wait([&] { return Take(value); });
+    Wake();
+    return value;
+  }
+
+private:
+  // the other side's index is read and our own stored sequentially
+  // consistent, so that Wake and Wait cannot both miss each other
+  bool Put(T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+    if (next == head_.load()) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next);
+    return true;
+  }
+
+  bool Take(T& value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load()) {
+      return false;
+    }
+    value = std::move(slots_[head]);
+    head_.store(head + 1 == slots_.size() ? 0 : head + 1);
+    return true;
+  }
+
+  template <typename Attempt>
+  void Wait(Attempt attempt) {
+    for (size_t tries = 0; tries < 128; ++tries) {
+      if (attempt()) {
+        return;
+      }
+      if (tries >= 64) {
+        std::this_thread::yield();
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    // either the other side's Wake sees the sleeper or the attempt sees
+    // the index it moved
+    sleepers_.fetch_add(1);
+    wake_.wait(lock, attempt);
+    sleepers_.fetch_sub(1);
+  }
+
+  // called after moving an index, for the other side asleep in Wait
+  void Wake() {
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_.notify_all();
+    }
+  }
+
+  // one slot stays empty to tell a full ring from an empty one
+  std::vector<T> slots_;
+  // next slot to pop, advanced by the consumer
+  alignas(64) std::atomic<size_t> head_{0};
+  // next slot to push into, advanced by the producer
+  alignas(64) std::atomic<size_t> tail_{0};
+  // threads in Wait past spinning; at most one, as both sides never wait
+  // at once
+  alignas(64) std::atomic<int> sleepers_{0};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+};
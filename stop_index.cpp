@@ -0,0 +1,143 @@
+#include "stop_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+// meters per degree of latitude (and of longitude on the equator)
+static const double METERS_PER_DEGREE = RADIUS * PI / 180;
+// stops per cell the grid is sized for
+static constexpr double STOPS_PER_CELL = 2;
+
+StopIndex::StopIndex(const vector<Coordinate>& coordinates) {
+    if (coordinates.empty()) {
+        cell_offsets_.assign(2, 0);
+        return;
+    }
+    double max_lat = coordinates.front().lat, max_lon = coordinates.front().lon;
+    min_lat_ = max_lat;
+    min_lon_ = max_lon;
+    for (const Coordinate& coordinate : coordinates) {
+        min_lat_ = min(min_lat_, coordinate.lat);
+        max_lat = max(max_lat, coordinate.lat);
+        min_lon_ = min(min_lon_, coordinate.lon);
+        max_lon = max(max_lon, coordinate.lon);
+    }
+    max_abs_lat_ = max(abs(min_lat_), abs(max_lat));
+
+    // square cells of equal area, as many as the stops need
+    const double cells = max(1.0, coordinates.size() / STOPS_PER_CELL);
+    const double height = (max_lat - min_lat_) * METERS_PER_DEGREE;
+    const double width = (max_lon - min_lon_) * METERS_PER_DEGREE * cos(ConvertToRad((min_lat_ + max_lat) / 2));
+    const double side = height > 0 && width > 0 ? sqrt(height * width / cells) : max(height, width) / cells;
+    if (side > 0) {
+        rows_ = static_cast<size_t>(clamp(ceil(height / side), 1.0, cells));
+        cols_ = static_cast<size_t>(clamp(ceil(width / side), 1.0, cells));
+    }
+    if (max_lat > min_lat_) {
+        cell_lat_ = (max_lat - min_lat_) / rows_;
+    }
+    if (max_lon > min_lon_) {
+        cell_lon_ = (max_lon - min_lon_) / cols_;
+    }
+
+    // counting sort of the stops by cell
+    vector<uint32_t> stop_cells(coordinates.size());
+    cell_offsets_.assign(GetCellCount() + 1, 0);
+    for (size_t stop = 0; stop < coordinates.size(); ++stop) {
+        const long row = clamp<long>(RowOf(coordinates[stop].lat), 0, rows_ - 1);
+        const long col = clamp<long>(ColOf(coordinates[stop].lon), 0, cols_ - 1);
+        stop_cells[stop] = static_cast<uint32_t>(row * cols_ + col);
+        ++cell_offsets_[stop_cells[stop] + 1];
+    }
+    partial_sum(begin(cell_offsets_), end(cell_offsets_), begin(cell_offsets_));
+    vector<uint32_t> filled(begin(cell_offsets_), end(cell_offsets_) - 1);
+    cell_stops_.resize(coordinates.size());
+    cell_coordinates_.resize(coordinates.size());
+    for (size_t stop = 0; stop < coordinates.size(); ++stop) {
+        const uint32_t slot = filled[stop_cells[stop]]++;
+        cell_stops_[slot] = static_cast<uint32_t>(stop);
+        cell_coordinates_[slot] = coordinates[stop];
+    }
+}
+
+long StopIndex::RowOf(double lat) const {
+    return static_cast<long>(floor((lat - min_lat_) / cell_lat_));
+}
+
+long StopIndex::ColOf(double lon) const {
+    return static_cast<long>(floor((lon - min_lon_) / cell_lon_));
+}
+
+vector<pair<uint32_t, double>> StopIndex::FindNearest(const Coordinate& point, size_t count) const {
+    count = min(count, cell_stops_.size());
+    if (count == 0) {
+        return {};
+    }
+    // cells of the same ring can hold a stop no closer than the rings
+    // between them and the point; a cell is narrowest along its parallel
+    // nearest the pole, and the margin covers the parallel being longer
+    // than the great circle
+    const double narrowest_lat = ConvertToRad(max(max_abs_lat_, abs(point.lat)));
+    const double cell_meters = min(cell_lat_, cell_lon_ * cos(narrowest_lat)) * METERS_PER_DEGREE * 0.99;
+
+    // the `count` best (distance, stop) so far, worst on top
+    vector<pair<double, uint32_t>> best;
+    best.reserve(count + 1);
+    auto visit_cell = [&](long row, long col) {
+        const size_t cell = row * cols_ + col;
+        for (size_t i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i) {
+            const pair<double, uint32_t> candidate{DistanceBetweenCoordinates(point, cell_coordinates_[i]), cell_stops_[i]};
+            if (best.size() < count) {
+                best.push_back(candidate);
+                push_heap(begin(best), end(best));
+            } else if (candidate < best.front()) {
+                pop_heap(begin(best), end(best));
+                best.back() = candidate;
+                push_heap(begin(best), end(best));
+            }
+        }
+    };
+
+    // the point may lie outside the grid; rings start at the first one
+    // touching it and end at the last
+    const long row = RowOf(point.lat), col = ColOf(point.lon);
+    const long last_row = rows_ - 1, last_col = cols_ - 1;
+    const long first_ring = max({0L, -row, row - last_row, -col, col - last_col});
+    const long last_ring = max({abs(row), abs(row - last_row), abs(col), abs(col - last_col)});
+    for (long ring = first_ring; ring <= last_ring; ++ring) {
+        if (best.size() == count && ring > 0 && (ring - 1) * cell_meters >= best.front().first) {
+            break;
+        }
+        if (ring == 0) {
+            visit_cell(row, col);
+            continue;
+        }
+        const long col_from = max(col - ring, 0L), col_to = min(col + ring, last_col);
+        for (const long r : {row - ring, row + ring}) {
+            if (r >= 0 && r <= last_row) {
+                for (long c = col_from; c <= col_to; ++c) {
+                    visit_cell(r, c);
+                }
+            }
+        }
+        const long row_from = max(row - ring + 1, 0L), row_to = min(row + ring - 1, last_row);
+        for (const long c : {col - ring, col + ring}) {
+            if (c >= 0 && c <= last_col) {
+                for (long r = row_from; r <= row_to; ++r) {
+                    visit_cell(r, c);
+                }
+            }
+        }
+    }
+
+    sort_heap(begin(best), end(best));
+    vector<pair<uint32_t, double>> result;
+    result.reserve(best.size());
+    for (const auto& [distance, stop] : best) {
+        result.emplace_back(stop, distance);
+    }
+    return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "response.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Static uniform grid over the stop coordinates for nearest-stop queries.
+// Cells are sized for a couple of stops each and the stops are stored cell
+// by cell, coordinates alongside, so a query reads a few short contiguous
+// runs. Rings of cells are visited outwards from the cell of the query
+// point until no unvisited cell can hold a stop closer than the k-th best.
+class StopIndex {
+public:
+    explicit StopIndex(const std::vector<Coordinate>& coordinates);
+
+    // up to `count` stops closest to the point by great-circle distance,
+    // nearest first, with the distance in meters
+    std::vector<std::pair<uint32_t, double>> FindNearest(const Coordinate& point, size_t count) const;
+
+    size_t GetCellCount() const {
+        return rows_ * cols_;
+    }
+
+private:
+    long RowOf(double lat) const;
+    long ColOf(double lon) const;
+
+    double min_lat_ = 0, min_lon_ = 0;
+    double max_abs_lat_ = 0;
+    // cell sides in degrees
+    double cell_lat_ = 1, cell_lon_ = 1;
+    size_t rows_ = 1, cols_ = 1;
+    std::vector<uint32_t> cell_offsets_;
+    std::vector<uint32_t> cell_stops_;
+    std::vector<Coordinate> cell_coordinates_;
+};
@@ -1,130 +1,676 @@
 #include "test_runner.h"
 #include "request.h"
 #include "route_manager.h"
+#include "snapshot_store.h"
+#include "response_stream.h"
+#include "server.h"
+#include "json.h"
+#include <cmath>
 #include <vector>
 #include <string>
+#include <random>
 #include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace std;
 
+// two routes over six stops; 750 runs A - B - C and back, 256 is the ring D > E > F > D
+const string BASE_REQUESTS = R"("base_requests": [
+    {"type": "Stop", "name": "A", "latitude": 55.611087, "longitude": 37.20829, "road_distances": {"B": 3900}},
+    {"type": "Stop", "name": "B", "latitude": 55.595884, "longitude": 37.209755, "road_distances": {"C": 9900}},
+    {"type": "Stop", "name": "C", "latitude": 55.632761, "longitude": 37.333324, "road_distances": {}},
+    {"type": "Bus", "name": "750", "stops": ["A", "B", "C"], "is_roundtrip": false},
+    {"type": "Stop", "name": "D", "latitude": 55.574371, "longitude": 37.6517, "road_distances": {"E": 1000}},
+    {"type": "Stop", "name": "E", "latitude": 55.581065, "longitude": 37.64839, "road_distances": {"F": 2000}},
+    {"type": "Stop", "name": "F", "latitude": 55.587655, "longitude": 37.645687, "road_distances": {"D": 3000}},
+    {"type": "Bus", "name": "256", "stops": ["D", "E", "F", "D"], "is_roundtrip": true},
+    {"type": "Stop", "name": "G", "latitude": 55.611678, "longitude": 37.603831, "road_distances": {}}
+])";
+
+Json::Document LoadDocument(const string& text) {
+    istringstream input(text);
+    return Json::Load(input);
+}
+
 void TestUpdateRequests(){
-    const string input = "10\n"
-        "Stop Tolstopaltsevo: 55.611087, 37.20829\n"
-        "Stop Marushkino: 55.595884, 37.209755\n"
-        "Bus 256: Biryulyovo Zapadnoye > Biryusinka > Universam > "
-        "Biryulyovo Tovarnaya > Biryulyovo Passazhirskaya > Biryulyovo Zapadnoye\n"
-        "Bus 750: Tolstopaltsevo - Marushkino - Rasskazovka\n"
-        "Stop Rasskazovka: 55.632761, 37.333324\n"
-        "Stop Biryulyovo Zapadnoye: 55.574371, 37.6517\n"
-        "Stop Biryusinka: 55.581065, 37.64839\n"
-        "Stop Universam: 55.587655, 37.645687\n"
-        "Stop Biryulyovo Tovarnaya: 55.592028, 37.653656\n"
-        "Stop Biryulyovo Passazhirskaya: 55.580999, 37.659164";
-    istringstream input_stream(input);
-    const auto update_requests = ReadRequests<0>(input_stream);
-    ASSERT_EQUAL(update_requests.size(), 10);
-    {
-        const auto& request = static_cast<const AddStopRequest&>(*update_requests[0]);
+    const auto document = LoadDocument("{" + BASE_REQUESTS + "}");
+    const auto update_requests = ReadRequests<BaseRequests>(document.GetRoot());
+    ASSERT_EQUAL(update_requests.size(), 9u);
+    {
+        const auto& request = get<AddStopRequest>(update_requests[0]);
         ASSERT_EQUAL(request.lat, 55.611087);
         ASSERT_EQUAL(request.lon, 37.20829);
-        ASSERT_EQUAL(request.stop, "Tolstopaltsevo");
-    }
-    
-    {
-        const vector<string> stops = {
-            "Biryulyovo Zapadnoye",
-            "Biryusinka",
-            "Universam",
-            "Biryulyovo Tovarnaya",
-            "Biryulyovo Passazhirskaya",
-            "Biryulyovo Zapadnoye"
-        };
-        const auto& request = static_cast<const AddRouteRequest&>(*update_requests[2]);
-        ASSERT_EQUAL(request.route, "256");
-        ASSERT_EQUAL(request.stops, stops);
+        ASSERT_EQUAL(request.stop, "A");
+        ASSERT_EQUAL(request.other_stops.size(), 1u);
+        ASSERT_EQUAL(request.other_stops[0].first, 3900);
+        ASSERT_EQUAL(request.other_stops[0].second, "B");
     }
     {
-        const vector<string> stops = {
-            "Tolstopaltsevo",
-            "Marushkino",
-            "Rasskazovka",
-            "Marushkino",
-            "Tolstopaltsevo"
-        };
-        const auto& request = static_cast<const AddRouteRequest&>(*update_requests[3]);
+        const vector<string> stops = {"A", "B", "C"};
+        const auto& request = get<AddRouteRequest>(update_requests[3]);
         ASSERT_EQUAL(request.route, "750");
         ASSERT_EQUAL(request.stops, stops);
+        ASSERT(!request.is_roundtrip);
+    }
+    {
+        const vector<string> stops = {"D", "E", "F", "D"};
+        const auto& request = get<AddRouteRequest>(update_requests[7]);
+        ASSERT_EQUAL(request.route, "256");
+        ASSERT_EQUAL(request.stops, stops);
+        ASSERT(request.is_roundtrip);
     }
 }
 
-
 void TestReadRequests(){
-    const string input = "5\n"
-                        "Bus 256\n"
-                        "Bus 750\n"
-                        "Bus 751 2 3\n"
-                        "Stop xyz\n"
-                        "Stop yu iu";
-    istringstream input_stream(input);
-    const auto update_requests = ReadRequests<1>(input_stream);
-    ASSERT_EQUAL(update_requests.size(), 5);
-    {
-        const auto& request = static_cast<const ReadRouteRequest&>(*update_requests[0]);
-        ASSERT_EQUAL(request.route, "256");
-    }
+    const auto document = LoadDocument(R"({"stat_requests": [
+        {"type": "Bus", "name": "751 2 3", "id": 1},
+        {"type": "Stop", "name": "yu iu", "id": 2},
+        {"type": "Route", "from": "A", "to": "C", "id": 3},
+        {"type": "Unknown", "name": "x", "id": 4}
+    ]})");
+    const auto read_requests = ReadRequests<StatRequests>(document.GetRoot());
+    ASSERT_EQUAL(read_requests.size(), 3u);
     {
-        const auto& request = static_cast<const ReadRouteRequest&>(*update_requests[2]);
+        const auto& request = get<ReadRouteRequest>(read_requests[0]);
         ASSERT_EQUAL(request.route, "751 2 3");
+        ASSERT_EQUAL(request.request_id, 1);
     }
     {
-        const auto& request = static_cast<const ReadStopRequest&>(*update_requests[3]);
-        ASSERT_EQUAL(request.stop, "xyz");
+        const auto& request = get<ReadStopRequest>(read_requests[1]);
+        ASSERT_EQUAL(request.stop, "yu iu");
+        ASSERT_EQUAL(request.request_id, 2);
     }
     {
-        const auto& request = static_cast<const ReadStopRequest&>(*update_requests[4]);
-        ASSERT_EQUAL(request.stop, "yu iu");
+        const auto& request = get<ReadRouteSearchRequest>(read_requests[2]);
+        ASSERT_EQUAL(request.from, "A");
+        ASSERT_EQUAL(request.to, "C");
+        ASSERT_EQUAL(request.request_id, 3);
     }
 }
 
 void TestResponses(){
-    const string input = "13\n"
-        "Stop Tolstopaltsevo: 55.611087, 37.20829\n"
-        "Stop Marushkino: 55.595884, 37.209755\n"
-        "Bus 256: Biryulyovo Zapadnoye > Biryusinka > Universam > "
-        "Biryulyovo Tovarnaya > Biryulyovo Passazhirskaya > Biryulyovo Zapadnoye\n"
-        "Bus 750: Tolstopaltsevo - Marushkino - Rasskazovka\n"
-        "Stop Rasskazovka: 55.632761, 37.333324\n"
-        "Stop Biryulyovo Zapadnoye: 55.574371, 37.6517\n"
-        "Stop Biryusinka: 55.581065, 37.64839\n"
-        "Stop Universam: 55.587655, 37.645687\n"
-        "Stop Biryulyovo Tovarnaya: 55.592028, 37.653656\n"
-        "Stop Biryulyovo Passazhirskaya: 55.580999, 37.659164\n"
-        "Bus 828: Biryulyovo Zapadnoye > Universam > Rossoshanskaya ulitsa > Biryulyovo Zapadnoye\n"
-        "Stop Rossoshanskaya ulitsa: 55.595579, 37.605757\n"
-        "Stop Prazhskaya: 55.611678, 37.603831\n"
-        "6\n"
-        "Bus 256\n"
-        "Bus 750\n"
-        "Bus 751\n"
-        "Stop Samara\n"
-        "Stop Prazhskaya\n"
-        "Stop Biryulyovo Zapadnoye";
-
-    istringstream input_stream(input);
-    const auto update_requests = ReadRequests<0>(input_stream);
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},)"
+        + BASE_REQUESTS + R"(, "stat_requests": [
+        {"type": "Bus", "name": "750", "id": 1},
+        {"type": "Bus", "name": "256", "id": 2},
+        {"type": "Bus", "name": "751", "id": 3},
+        {"type": "Stop", "name": "Samara", "id": 4},
+        {"type": "Stop", "name": "G", "id": 5},
+        {"type": "Stop", "name": "D", "id": 6}
+    ]})");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    const auto responses = ProcessRequests(ReadRequests<StatRequests>(document.GetRoot()), manager);
+    ASSERT_EQUAL(responses.size(), 6u);
+    {
+        // the way back falls back to the distances of the way there
+        const auto& response = get<ReadRouteResponse>(responses[0]);
+        ASSERT_EQUAL(response.request_id, 1);
+        ASSERT(response.stats.has_value());
+        ASSERT_EQUAL(response.stats->stops, 5u);
+        ASSERT_EQUAL(response.stats->unique_stops, 3u);
+        ASSERT_EQUAL(response.stats->length, 27600);
+    }
+    {
+        const auto& response = get<ReadRouteResponse>(responses[1]);
+        ASSERT_EQUAL(response.stats->stops, 4u);
+        ASSERT_EQUAL(response.stats->unique_stops, 3u);
+        ASSERT_EQUAL(response.stats->length, 6000);
+    }
+    ASSERT(!get<ReadRouteResponse>(responses[2]).stats);
+    ASSERT(!get<ReadStopResponse>(responses[3]).hasStop);
+    {
+        const auto& response = get<ReadStopResponse>(responses[4]);
+        ASSERT(response.hasStop);
+        ASSERT(!response.stats);
+    }
+    {
+        const auto& response = get<ReadStopResponse>(responses[5]);
+        ASSERT_EQUAL(response.stats->routes, set<string>({"256"}));
+    }
+
+    stringstream output_stream;
+    PrintResponses(responses, output_stream);
+    const auto printed = LoadDocument(output_stream.str());
+    ASSERT_EQUAL(printed.GetRoot().AsArray().size(), 6u);
+    ASSERT_EQUAL(printed.GetRoot().AsArray()[0].AsMap().at("route_length").AsDouble(), 27600);
+}
+
+// every router mode finds the same itineraries
+void TestRouteSearch(){
+    const vector<string> modes = {"", "dijkstra", "astar", "alt", "bidirectional", "raptor", "tree_cache", "hub_labels", "crp"};
+    for (const string& mode : modes) {
+        const string router = mode.empty() ? "" : R"(, "router": ")" + mode + "\"";
+        const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40)"
+            + router + "}," + BASE_REQUESTS + "}");
+        RouteManager manager;
+        ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+        manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+        {
+            const auto response = manager.ReadRouteSearch("A", "C", 1);
+            ASSERT(response.stats.has_value());
+            ASSERT_EQUAL(response.stats->size(), 2u);
+            const auto& ride = get<BusRouteSearchStats>((*response.stats)[1]);
+            ASSERT_EQUAL(ride.bus_name_, "750");
+            ASSERT_EQUAL(ride.span_count_, 2);
+            // 6 minutes of waiting, then 13.8 km at 40 km/h
+            ASSERT(abs(response.total_time - (6 + 13800 / (40 * 1000.0 / 60))) < 1e-9);
+        }
+        {
+            const auto response = manager.ReadRouteSearch("C", "A", 2);
+            ASSERT(abs(response.total_time - (6 + 13800 / (40 * 1000.0 / 60))) < 1e-9);
+        }
+        {
+            const auto response = manager.ReadRouteSearch("E", "D", 3);
+            ASSERT(abs(response.total_time - (6 + 5000 / (40 * 1000.0 / 60))) < 1e-9);
+        }
+        {
+            ASSERT(!manager.ReadRouteSearch("A", "D", 4).stats);
+        }
+        {
+            const auto response = manager.ReadRouteSearch("B", "B", 5);
+            ASSERT(response.stats.has_value());
+            ASSERT_EQUAL(response.total_time, 0.0);
+        }
+        {
+            // one search from A answers all of them as single queries would
+            const auto responses = manager.ReadRouteSearches("A", {{"C", 6}, {"D", 7}, {"A", 8}, {"C", 9}});
+            ASSERT_EQUAL(responses.size(), 4u);
+            for (const auto& response : responses) {
+                const auto& to = response.request_id == 7 ? "D" : response.request_id == 8 ? "A" : "C";
+                const auto single = manager.ReadRouteSearch("A", to, response.request_id);
+                ASSERT_EQUAL(response.stats.has_value(), single.stats.has_value());
+                ASSERT_EQUAL(response.total_time, single.total_time);
+            }
+        }
+    }
+}
+
+// the fastest itinerary first, then the slower loopless ones; A - C has two
+void TestRouteAlternatives(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},)"
+        + BASE_REQUESTS + R"(, "stat_requests": [
+        {"type": "Route", "from": "A", "to": "C", "id": 1, "alternatives": 3},
+        {"type": "Route", "from": "A", "to": "D", "id": 2, "alternatives": 3}
+    ]})");
     RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    const auto requests = ReadRequests<StatRequests>(document.GetRoot());
+    ASSERT_EQUAL(get<ReadRouteSearchRequest>(requests[0]).alternatives, 3u);
+    const auto responses = ProcessRequests(requests, manager);
+    {
+        const auto& response = get<ReadRouteSearchResponse>(responses[0]);
+        ASSERT_EQUAL(response.stats->size(), 2u);
+        ASSERT(abs(response.total_time - (6 + 13800 / (40 * 1000.0 / 60))) < 1e-9);
+        // changing buses at B
+        ASSERT_EQUAL(response.alternatives.size(), 1u);
+        const auto& alternative = response.alternatives[0];
+        ASSERT_EQUAL(alternative.items.size(), 4u);
+        ASSERT_EQUAL(get<WaitRouteSearchStats>(alternative.items[2]).stop_name_, "B");
+        ASSERT(abs(alternative.total_time - (12 + 13800 / (40 * 1000.0 / 60))) < 1e-9);
+    }
+    ASSERT(!get<ReadRouteSearchResponse>(responses[1]).stats);
+
+    stringstream output_stream;
+    PrintResponses(responses, output_stream);
+    const auto printed = LoadDocument(output_stream.str());
+    const auto& alternatives = printed.GetRoot().AsArray()[0].AsMap().at("alternatives").AsArray();
+    ASSERT_EQUAL(alternatives.size(), 1u);
+    ASSERT_EQUAL(alternatives[0].AsMap().at("items").AsArray().size(), 4u);
+}
 
-    ProcessRequests(update_requests, manager);
-    const auto read_requests = ReadRequests<1>(input_stream);
-    const auto responses = ProcessRequests(read_requests, manager);
+// a slow direct bus and a faster pair of buses: both journeys are Pareto-optimal
+void TestParetoRoute(){
+    for (const char* router : {"dijkstra", "raptor"}) {
+        const auto document = LoadDocument(string(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40, "router": ")")
+            + router + R"("}, "base_requests": [
+            {"type": "Stop", "name": "X", "latitude": 55.6, "longitude": 37.6, "road_distances": {"Z": 10000, "Y": 1000}},
+            {"type": "Stop", "name": "Y", "latitude": 55.605, "longitude": 37.6, "road_distances": {"Z": 1000}},
+            {"type": "Stop", "name": "Z", "latitude": 55.61, "longitude": 37.6, "road_distances": {}},
+            {"type": "Stop", "name": "W", "latitude": 55.62, "longitude": 37.6, "road_distances": {}},
+            {"type": "Bus", "name": "slow", "stops": ["X", "Z"], "is_roundtrip": false},
+            {"type": "Bus", "name": "first", "stops": ["X", "Y"], "is_roundtrip": false},
+            {"type": "Bus", "name": "second", "stops": ["Y", "Z"], "is_roundtrip": false}
+        ], "stat_requests": [
+            {"type": "ParetoRoute", "from": "X", "to": "Z", "id": 1},
+            {"type": "ParetoRoute", "from": "Z", "to": "W", "id": 2},
+            {"type": "ParetoRoute", "from": "Y", "to": "Y", "id": 3},
+            {"type": "Route", "from": "X", "to": "Z", "id": 4}
+        ]})");
+        RouteManager manager;
+        ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+        manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+        const auto responses = ProcessRequests(ReadRequests<StatRequests>(document.GetRoot()), manager);
+        {
+            const auto& response = get<ReadParetoRouteResponse>(responses[0]);
+            ASSERT(response.journeys.has_value());
+            ASSERT_EQUAL(response.journeys->size(), 2u);
+            const auto& direct = (*response.journeys)[0];
+            ASSERT_EQUAL(direct.items.size(), 2u);
+            ASSERT_EQUAL(get<BusRouteSearchStats>(direct.items[1]).bus_name_, "slow");
+            ASSERT(abs(direct.total_time - (6 + 10000 / (40 * 1000.0 / 60))) < 1e-9);
+            const auto& changing = (*response.journeys)[1];
+            ASSERT_EQUAL(changing.items.size(), 4u);
+            ASSERT_EQUAL(get<WaitRouteSearchStats>(changing.items[2]).stop_name_, "Y");
+            ASSERT(abs(changing.total_time - (12 + 2000 / (40 * 1000.0 / 60))) < 1e-9);
+        }
+        ASSERT(!get<ReadParetoRouteResponse>(responses[1]).journeys);
+        {
+            const auto& journeys = *get<ReadParetoRouteResponse>(responses[2]).journeys;
+            ASSERT_EQUAL(journeys.size(), 1u);
+            ASSERT(journeys[0].items.empty());
+        }
+        ASSERT(abs(get<ReadRouteSearchResponse>(responses[3]).total_time - (12 + 2000 / (40 * 1000.0 / 60))) < 1e-9);
+
+        stringstream output_stream;
+        PrintResponses(responses, output_stream);
+        const auto printed = LoadDocument(output_stream.str());
+        const auto& journeys = printed.GetRoot().AsArray()[0].AsMap().at("journeys").AsArray();
+        ASSERT_EQUAL(journeys.size(), 2u);
+        ASSERT_EQUAL(journeys[0].AsMap().at("transfers").AsDouble(), 0);
+        ASSERT_EQUAL(journeys[1].AsMap().at("transfers").AsDouble(), 1);
+    }
+}
+
+// 1 leaves X at 8:00 and reaches Y at 8:02, 2 leaves Y at 8:01 and 8:10
+void TestTimetableRoute(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 60}, "base_requests": [
+        {"type": "Stop", "name": "X", "latitude": 55.6, "longitude": 37.6, "road_distances": {"Y": 2000}},
+        {"type": "Stop", "name": "Y", "latitude": 55.61, "longitude": 37.6, "road_distances": {"Z": 3000}},
+        {"type": "Stop", "name": "Z", "latitude": 55.62, "longitude": 37.6, "road_distances": {}},
+        {"type": "Bus", "name": "1", "stops": ["X", "Y"], "is_roundtrip": false, "departures": [480]},
+        {"type": "Bus", "name": "2", "stops": ["Y", "Z"], "is_roundtrip": false, "departures": [481, 490]}
+    ], "stat_requests": [
+        {"type": "Route", "from": "X", "to": "Z", "id": 1, "departure_time": 470},
+        {"type": "Route", "from": "X", "to": "Z", "id": 2, "departure_time": 480.5},
+        {"type": "Route", "from": "X", "to": "Z", "id": 3, "departure_time": 479.5},
+        {"type": "Route", "from": "X", "to": "Z", "id": 4}
+    ]})");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    const auto responses = ProcessRequests(ReadRequests<StatRequests>(document.GetRoot()), manager);
+    {
+        const auto& response = get<ReadRouteSearchResponse>(responses[0]);
+        ASSERT(response.stats.has_value());
+        ASSERT_EQUAL(response.stats->size(), 4u);
+        ASSERT_EQUAL(get<WaitRouteSearchStats>((*response.stats)[0]).time_, 10.0);
+        ASSERT_EQUAL(get<BusRouteSearchStats>((*response.stats)[1]).bus_name_, "1");
+        ASSERT_EQUAL(get<BusRouteSearchStats>((*response.stats)[1]).time_, 2.0);
+        ASSERT_EQUAL(get<WaitRouteSearchStats>((*response.stats)[2]).time_, 8.0);
+        ASSERT_EQUAL(get<BusRouteSearchStats>((*response.stats)[3]).span_count_, 1);
+        ASSERT_EQUAL(response.total_time, 23.0);
+    }
+    // the only trip of 1 has left
+    ASSERT(!get<ReadRouteSearchResponse>(responses[1]).stats);
+    ASSERT_EQUAL(get<ReadRouteSearchResponse>(responses[2]).total_time, 13.5);
+    // without a departure time the frequency model answers
+    ASSERT_EQUAL(get<ReadRouteSearchResponse>(responses[3]).total_time, 17.0);
 
-    const string expected = "Bus 256: 6 stops on route, 5 unique stops, 4371.017264 route length\n"
-                            "Bus 750: 5 stops on route, 3 unique stops, 20939.483047 route length\n"
-                            "Bus 751: not found\n"
-                            "Stop Samara: not found\n"
-                            "Stop Prazhskaya: no buses\n"
-                            "Stop Biryulyovo Zapadnoye: buses 256 828 \n";
     stringstream output_stream;
     PrintResponses(responses, output_stream);
-    ASSERT_EQUAL(output_stream.str(), expected);
-}
\ No newline at end of file
+    const auto printed = LoadDocument(output_stream.str());
+    const auto& items = printed.GetRoot().AsArray()[2].AsMap().at("items").AsArray();
+    ASSERT_EQUAL(items[0].AsMap().at("time").AsDouble(), 0.5);
+}
+
+// 480 + 0.3 - 480 is not 0.3 in doubles: rides come from the schedule
+void TestTimetableRideTime(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 60}, "base_requests": [
+        {"type": "Stop", "name": "X", "latitude": 55.6, "longitude": 37.6, "road_distances": {"Y": 300}},
+        {"type": "Stop", "name": "Y", "latitude": 55.6001, "longitude": 37.6, "road_distances": {}},
+        {"type": "Bus", "name": "1", "stops": ["X", "Y"], "is_roundtrip": false, "departures": [480]}
+    ], "stat_requests": [
+        {"type": "Route", "from": "X", "to": "Y", "id": 1, "departure_time": 480},
+        {"type": "Route", "from": "X", "to": "Y", "id": 2}
+    ]})");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    const auto responses = ProcessRequests(ReadRequests<StatRequests>(document.GetRoot()), manager);
+    const auto& timed = *get<ReadRouteSearchResponse>(responses[0]).stats;
+    const auto& frequent = *get<ReadRouteSearchResponse>(responses[1]).stats;
+    ASSERT_EQUAL(timed.size(), 2u);
+    ASSERT_EQUAL(get<WaitRouteSearchStats>(timed[0]).time_, 0.0);
+    ASSERT_EQUAL(get<BusRouteSearchStats>(timed[1]).time_, get<BusRouteSearchStats>(frequent[1]).time_);
+    ASSERT(get<BusRouteSearchStats>(timed[1]).time_ != (480 + get<BusRouteSearchStats>(timed[1]).time_) - 480);
+}
+
+// A, B and C about 1100 m apart on one meridian; walking is 100 m a minute
+void TestCoordinateRoute(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 60, "pedestrian_velocity": 6, "access_stops": 2}, "base_requests": [
+        {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.6, "road_distances": {"B": 1000}},
+        {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.6, "road_distances": {"C": 1000}},
+        {"type": "Stop", "name": "C", "latitude": 55.62, "longitude": 37.6, "road_distances": {}},
+        {"type": "Bus", "name": "1", "stops": ["A", "B", "C"], "is_roundtrip": false}
+    ], "stat_requests": [
+        {"type": "NearestStops", "latitude": 55.6001, "longitude": 37.6, "count": 2, "id": 1},
+        {"type": "Route", "from": {"latitude": 55.6001, "longitude": 37.6}, "to": {"latitude": 55.6199, "longitude": 37.6}, "id": 2},
+        {"type": "Route", "from": {"latitude": 55.6001, "longitude": 37.6}, "to": {"latitude": 55.6005, "longitude": 37.6}, "id": 3},
+        {"type": "Route", "from": "A", "to": {"latitude": 55.6199, "longitude": 37.6}, "id": 4}
+    ]})");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    const auto responses = ProcessRequests(ReadRequests<StatRequests>(document.GetRoot()), manager);
+    {
+        const auto& nearest = get<ReadNearestStopsResponse>(responses[0]);
+        ASSERT_EQUAL(nearest.stops.size(), 2u);
+        ASSERT_EQUAL(nearest.stops[0].first, "A");
+        ASSERT_EQUAL(nearest.stops[1].first, "B");
+        ASSERT(abs(nearest.stops[0].second - 11.1) < 0.1);
+    }
+    {
+        const auto& response = get<ReadRouteSearchResponse>(responses[1]);
+        ASSERT(response.stats.has_value());
+        ASSERT_EQUAL(response.stats->size(), 4u);
+        ASSERT_EQUAL(get<WalkRouteSearchStats>((*response.stats)[0]).stop_name_, "A");
+        ASSERT_EQUAL(get<BusRouteSearchStats>((*response.stats)[2]).span_count_, 2);
+        ASSERT_EQUAL(get<WalkRouteSearchStats>((*response.stats)[3]).stop_name_, "C");
+        ASSERT(abs(response.total_time - 8.222) < 0.01);
+    }
+    {
+        // closer than any stop: straight there on foot
+        const auto& response = get<ReadRouteSearchResponse>(responses[2]);
+        ASSERT_EQUAL(response.stats->size(), 1u);
+        ASSERT_EQUAL(get<WalkRouteSearchStats>((*response.stats)[0]).stop_name_, "");
+        ASSERT(abs(response.total_time - 0.445) < 0.01);
+    }
+    ASSERT_EQUAL(get<ReadRouteSearchResponse>(responses[3]).stats->size(), 3u);
+
+    stringstream output_stream;
+    PrintResponses(responses, output_stream);
+    const auto printed = LoadDocument(output_stream.str());
+    ASSERT_EQUAL(printed.GetRoot().AsArray()[0].AsMap().at("stops").AsArray().size(), 2u);
+    const auto& items = printed.GetRoot().AsArray()[1].AsMap().at("items").AsArray();
+    ASSERT_EQUAL(items[0].AsMap().at("type").AsString(), "Walk");
+}
+
+void TestSearchQueue(){
+    Graph::SearchQueue<int64_t, int> queue;
+    for (const int64_t key : {40, 7, 19, 7, 1000000007}) {
+        queue.push(key, static_cast<int>(key % 100));
+    }
+    ASSERT_EQUAL(queue.pop().first, 7);
+    queue.push(12, 12);
+    // below the last key popped: comes out as that key
+    queue.push(3, 3);
+    vector<int64_t> keys;
+    while (!queue.empty()) {
+        keys.push_back(queue.pop().first);
+    }
+    ASSERT_EQUAL(keys, (vector<int64_t>{7, 7, 12, 19, 40, 1000000007}));
+}
+
+// room for two trees: the least recently used one goes first
+void TestTreeCache(){
+    const Graph::DirectedWeightedGraph<int64_t> graph(4, {{0, 1, 5}, {1, 2, 5}, {2, 3, 5}, {0, 2, 12}});
+    Graph::TreeCache<int64_t> cache(graph, 2 * 4 * (sizeof(int64_t) + sizeof(Graph::EdgeId)));
+    ASSERT_EQUAL(cache.GetCapacity(), 2u);
+    ASSERT_EQUAL(cache.FindPath(0, 3)->weight, 15);
+    ASSERT_EQUAL(cache.FindPath(0, 2)->edges, (vector<Graph::EdgeId>{0, 1}));
+    ASSERT(!cache.FindPath(1, 0));
+    ASSERT_EQUAL(cache.FindPath(0, 1)->weight, 5);
+    ASSERT_EQUAL(cache.FindPath(2, 3)->weight, 5);
+    ASSERT_EQUAL(cache.FindPath(1, 3)->weight, 10);
+    const auto stats = cache.GetStats();
+    ASSERT_EQUAL(stats.hits, 2u);
+    ASSERT_EQUAL(stats.misses, 4u);
+    ASSERT_EQUAL(stats.evictions, 2u);
+    ASSERT_EQUAL(cache.GetSize(), 2u);
+}
+
+// the lightest of parallel edges survives, the first one of a tie
+void TestMergeParallelEdges(){
+    vector<Graph::Edge<int>> edges = {{0, 1, 5}, {1, 2, 3}, {0, 1, 4}, {0, 2, 9}, {0, 1, 4}, {1, 2, 3}};
+    const auto kept = Graph::MergeParallelEdges(3, edges);
+    ASSERT_EQUAL(kept, (vector<Graph::EdgeId>{1, 2, 3}));
+    ASSERT_EQUAL(edges.size(), 3u);
+    ASSERT_EQUAL(edges[1].weight, 4);
+}
+
+// a bus looping B > C > B: riding A to D through the loop loses to
+// getting off at B and on again after it
+void TestPruneDominatedEdges(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 2, "bus_velocity": 60}, "base_requests": [
+        {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.6, "road_distances": {"B": 1000}},
+        {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.6, "road_distances": {"C": 5000, "D": 1000}},
+        {"type": "Stop", "name": "C", "latitude": 55.62, "longitude": 37.6, "road_distances": {}},
+        {"type": "Stop", "name": "D", "latitude": 55.63, "longitude": 37.6, "road_distances": {}},
+        {"type": "Bus", "name": "1", "stops": ["A", "B", "C", "B", "D"], "is_roundtrip": false}
+    ]})");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    RoutingSettings settings = ReadSettings(document.GetRoot());
+    settings.router = RouterMode::DIJKSTRA;
+    const size_t all_edges = manager.BuildGraph(settings);
+    settings.prune_dominated_edges = true;
+    // A to D and D to A
+    ASSERT_EQUAL(manager.BuildGraph(settings), all_edges - 2);
+    manager.PrecomputeRouter();
+    const auto response = manager.ReadRouteSearch("A", "D", 1);
+    ASSERT_EQUAL(response.stats->size(), 4u);
+    ASSERT(abs(response.total_time - 6) < 1e-9);
+}
+
+// shortcuts across two levels of cells, customized again after the
+// weights change, give the distances of a plain search
+void TestMultilevelOverlay(){
+    // a 4 x 4 grid in both directions, cells of 4 and then 8 vertices
+    const size_t side = 4;
+    Graph::DirectedWeightedGraph<int> graph(side * side);
+    mt19937 rng(3);
+    for (Graph::VertexId vertex = 0; vertex < side * side; ++vertex) {
+        if (vertex % side + 1 < side) {
+            graph.AddEdge({vertex, vertex + 1, static_cast<int>(rng() % 9 + 1)});
+            graph.AddEdge({vertex + 1, vertex, static_cast<int>(rng() % 9 + 1)});
+        }
+        if (vertex + side < side * side) {
+            graph.AddEdge({vertex, vertex + side, static_cast<int>(rng() % 9 + 1)});
+            graph.AddEdge({vertex + side, vertex, static_cast<int>(rng() % 9 + 1)});
+        }
+    }
+    vector<vector<uint32_t>> cells(2, vector<uint32_t>(side * side));
+    for (Graph::VertexId vertex = 0; vertex < side * side; ++vertex) {
+        cells[0][vertex] = vertex / 4;
+        cells[1][vertex] = vertex / 8;
+    }
+    Graph::MultilevelOverlay<int> overlay(graph, cells);
+    ASSERT_EQUAL(overlay.GetLevelCount(), 2u);
+    ASSERT_EQUAL(overlay.GetCellCount(0), 4u);
+    for (int round = 0; round < 2; ++round) {
+        overlay.Customize(2);
+        const Graph::PathSearch<int> search(graph);
+        for (Graph::VertexId from = 0; from < side * side; ++from) {
+            for (Graph::VertexId to = 0; to < side * side; ++to) {
+                const auto path = overlay.FindPath(from, to);
+                ASSERT(path.has_value());
+                ASSERT_EQUAL(path->weight, search.FindPath(from, to)->weight);
+                int weight = 0;
+                Graph::VertexId vertex = from;
+                for (const Graph::EdgeId edge_id : path->edges) {
+                    ASSERT_EQUAL(graph.GetEdge(edge_id).from, vertex);
+                    weight += graph.GetEdge(edge_id).weight;
+                    vertex = graph.GetEdge(edge_id).to;
+                }
+                ASSERT_EQUAL(vertex, to);
+                ASSERT_EQUAL(weight, path->weight);
+            }
+        }
+        for (Graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            graph.SetEdgeWeight(edge_id, static_cast<int>(rng() % 9 + 1));
+        }
+    }
+}
+
+// new wait and velocity with the CRP router answer as a fresh build does
+void TestUpdateRoutingSettings(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40, "router": "crp"},)"
+        + BASE_REQUESTS + "}");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    RoutingSettings settings = ReadSettings(document.GetRoot());
+    manager.RunGraphBuilder(settings);
+    settings.bus_wait_time = 2;
+    settings.bus_velocity = 30 * 1000.0 / 60;
+    manager.UpdateRoutingSettings(settings);
+    const auto response = manager.ReadRouteSearch("A", "C", 1);
+    ASSERT(abs(response.total_time - (2 + 13800 / (30 * 1000.0 / 60))) < 1e-9);
+    ASSERT_EQUAL(get<WaitRouteSearchStats>((*response.stats)[0]).time_, 2.0);
+}
+
+// a reader keeps the snapshot it took while a rebuild swaps in the next
+void TestSnapshotStore(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},)"
+        + BASE_REQUESTS + "}");
+    const auto base_requests = ReadRequests<BaseRequests>(document.GetRoot());
+    RoutingSettings settings = ReadSettings(document.GetRoot());
+    SnapshotStore store(base_requests, settings);
+    const auto first = store.Get();
+    ASSERT_EQUAL(first->version, 1u);
+
+    settings.bus_wait_time = 2;
+    store.Rebuild(base_requests, settings);
+    ASSERT_EQUAL(store.Wait(), 2u);
+    const auto second = store.Get();
+    ASSERT_EQUAL(second->version, 2u);
+    const double ride = 13800 / (40 * 1000.0 / 60);
+    ASSERT(abs(first->manager.ReadRouteSearch("A", "C", 1).total_time - (6 + ride)) < 1e-9);
+    ASSERT(abs(second->manager.ReadRouteSearch("A", "C", 1).total_time - (2 + ride)) < 1e-9);
+    ASSERT_EQUAL(store.GetRetiredCount(), 1u);
+}
+
+// streamed through small chunks and ring, the array prints as PrintResponses has it
+void TestResponseStream(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},)"
+        + BASE_REQUESTS + "}");
+    RouteManager manager;
+    ProcessRequests(ReadRequests<BaseRequests>(document.GetRoot()), manager);
+    manager.RunGraphBuilder(ReadSettings(document.GetRoot()));
+    vector<Response> responses;
+    for (int i = 0; i < 50; ++i) {
+        responses.push_back(manager.ReadRouteSearch("A", "C", i));
+        responses.push_back(manager.ReadStop("B", i));
+    }
+    for (const size_t count : {0, 1, 100}) {
+        const vector<Response> printed(responses.begin(), responses.begin() + count);
+        ostringstream expected, streamed;
+        PrintResponses(printed, expected);
+        {
+            ResponseStream stream(streamed, 64, 2);
+            for (const auto& response : printed) {
+                stream.Add(response);
+            }
+            stream.Finish();
+        }
+        ASSERT_EQUAL(streamed.str(), expected.str());
+    }
+    // dropped unfinished, as when an answer throws, the array stays open
+    {
+        ostringstream streamed;
+        {
+            ResponseStream stream(streamed, 64, 2);
+            for (const auto& response : responses) {
+                stream.Add(response);
+            }
+        }
+        ASSERT(!streamed.str().empty());
+        ASSERT(streamed.str().back() != ']');
+    }
+
+    SpscRing<int> ring(3);
+    thread producer([&ring] {
+        for (int i = 1; i <= 10000; ++i) {
+            ring.Push(i);
+        }
+    });
+    for (int i = 1; i <= 10000; ++i) {
+        ASSERT_EQUAL(ring.Pop(), i);
+    }
+    producer.join();
+}
+
+// a client that hangs up with answers still due takes down its own
+// connection only; the next client is served as before
+void TestServerDisconnect(){
+    const auto document = LoadDocument(R"({"routing_settings": {"bus_wait_time": 6, "bus_velocity": 40},)"
+        + BASE_REQUESTS + "}");
+    const SnapshotStore store(ReadRequests<BaseRequests>(document.GetRoot()), ReadSettings(document.GetRoot()));
+    ServerOptions options;
+    options.socket_path = "/tmp/transport_tests_server.sock";
+    RequestServer server(store, options);
+    thread server_thread([&server] { server.Run(); });
+
+    auto connect_client = [&options] {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        copy(options.socket_path.begin(), options.socket_path.end(), address.sun_path);
+        ASSERT_EQUAL(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        return fd;
+    };
+    auto send_all = [](int fd, const string& text) {
+        for (size_t sent = 0; sent < text.size(); ) {
+            sent += send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        }
+    };
+    string requests;
+    for (int i = 0; i < 2000; ++i) {
+        requests += R"({"type": "Route", "from": "A", "to": "C", "id": )" + to_string(i) + "}\n";
+    }
+    for (int round = 0; round < 3; ++round) {
+        const int fd = connect_client();
+        send_all(fd, requests);
+        close(fd);
+    }
+
+    const int fd = connect_client();
+    send_all(fd, "{\"type\": \"Stop\", \"name\": \"B\", \"id\": 7}\n");
+    string response;
+    char buffer[4096];
+    while (response.find('\n') == string::npos) {
+        const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        ASSERT(size > 0);
+        response.append(buffer, size);
+    }
+    close(fd);
+    server.Stop();
+    server_thread.join();
+    ASSERT(response.find("\"request_id\": 7") != string::npos);
+
+    // a failed request is told apart by its id when it has one
+    const auto snapshot = store.Get();
+    ASSERT_EQUAL(RequestServer::ProcessLine(snapshot->manager, R"({"type": "Unknown", "id": 3})"),
+                 R"({"request_id": 3, "error_message": "unknown request type"})");
+    const string malformed = RequestServer::ProcessLine(snapshot->manager, "[");
+    ASSERT(malformed.find("error_message") != string::npos);
+    ASSERT(malformed.find("request_id") == string::npos);
+}
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestUpdateRequests);
+    RUN_TEST(tr, TestReadRequests);
+    RUN_TEST(tr, TestResponses);
+    RUN_TEST(tr, TestRouteSearch);
+    RUN_TEST(tr, TestRouteAlternatives);
+    RUN_TEST(tr, TestParetoRoute);
+    RUN_TEST(tr, TestTimetableRoute);
+    RUN_TEST(tr, TestTimetableRideTime);
+    RUN_TEST(tr, TestCoordinateRoute);
+    RUN_TEST(tr, TestSearchQueue);
+    RUN_TEST(tr, TestTreeCache);
+    RUN_TEST(tr, TestMergeParallelEdges);
+    RUN_TEST(tr, TestPruneDominatedEdges);
+    RUN_TEST(tr, TestMultilevelOverlay);
+    RUN_TEST(tr, TestUpdateRoutingSettings);
+    RUN_TEST(tr, TestSnapshotStore);
+    RUN_TEST(tr, TestResponseStream);
+    RUN_TEST(tr, TestServerDisconnect);
+}
@@ -0,0 +1,112 @@
+#include "timetable.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+static constexpr double NOT_REACHED = numeric_limits<double>::infinity();
+
+thread_local size_t Timetable::last_scanned_ = 0;
+
+Timetable::Timetable(size_t stop_count, const vector<Schedule>& schedules) : stop_count_(stop_count) {
+    size_t connection_count = 0;
+    size_t minute_count = 0;
+    for (const Schedule& schedule : schedules) {
+        if (schedule.stops.size() > 1) {
+            connection_count += (schedule.stops.size() - 1) * schedule.departures.size();
+        }
+        minute_count += schedule.minutes.size();
+    }
+    connections_.reserve(connection_count);
+    minutes_.reserve(minute_count);
+    for (const Schedule& schedule : schedules) {
+        const auto minutes = static_cast<uint32_t>(minutes_.size());
+        minutes_.insert(end(minutes_), begin(schedule.minutes), end(schedule.minutes));
+        for (const double departure : schedule.departures) {
+            const auto trip = static_cast<uint32_t>(trips_.size());
+            trips_.push_back({schedule.route, minutes});
+            for (size_t i = 1; i < schedule.stops.size(); ++i) {
+                connections_.push_back({departure + schedule.minutes[i - 1], departure + schedule.minutes[i],
+                                        schedule.stops[i - 1], schedule.stops[i], trip, static_cast<uint32_t>(i - 1)});
+            }
+        }
+    }
+    // ties on departure go to the earlier arrival; connections of one trip
+    // leaving and arriving at the same time stay in travel order
+    stable_sort(begin(connections_), end(connections_), [](const Connection& lhs, const Connection& rhs) {
+        return lhs.departure < rhs.departure || (lhs.departure == rhs.departure && lhs.arrival < rhs.arrival);
+    });
+}
+
+optional<Raptor::Journey> Timetable::FindJourney(uint32_t from, uint32_t to, double departure_time) const {
+    last_scanned_ = 0;
+    if (from == to) {
+        return Raptor::Journey{{}, 0};
+    }
+    Workspace& ws = GetWorkspace();
+    if (ws.arrival.size() != stop_count_ || ws.boarded.size() != trips_.size() || ++ws.generation == 0) {
+        ws.arrival.assign(stop_count_, NOT_REACHED);
+        ws.reached.assign(stop_count_, 0);
+        ws.leg.assign(stop_count_, {0, 0});
+        ws.boarded_at.assign(trips_.size(), 0);
+        ws.boarded.assign(trips_.size(), 0);
+        ws.generation = 1;
+    }
+    auto arrival = [&ws](uint32_t stop) {
+        return ws.reached[stop] == ws.generation ? ws.arrival[stop] : NOT_REACHED;
+    };
+    ws.reached[from] = ws.generation;
+    ws.arrival[from] = departure_time;
+
+    const auto first = partition_point(begin(connections_), end(connections_), [departure_time](const Connection& c) {
+        return c.departure < departure_time;
+    });
+    size_t scanned = 0;
+    double target_arrival = NOT_REACHED;
+    for (auto it = first; it != end(connections_); ++it) {
+        const Connection& c = *it;
+        // connections only get later from here on
+        if (c.departure >= target_arrival) {
+            break;
+        }
+        ++scanned;
+        if (ws.boarded[c.trip] != ws.generation) {
+            if (arrival(c.from_stop) > c.departure) {
+                continue;
+            }
+            ws.boarded[c.trip] = ws.generation;
+            ws.boarded_at[c.trip] = static_cast<uint32_t>(it - begin(connections_));
+        }
+        if (c.arrival < arrival(c.to_stop)) {
+            ws.reached[c.to_stop] = ws.generation;
+            ws.arrival[c.to_stop] = c.arrival;
+            ws.leg[c.to_stop] = {ws.boarded_at[c.trip], static_cast<uint32_t>(it - begin(connections_))};
+            if (c.to_stop == to) {
+                target_arrival = c.arrival;
+            }
+        }
+    }
+    last_scanned_ = scanned;
+    if (target_arrival == NOT_REACHED) {
+        return nullopt;
+    }
+
+    // a stop's arrival never changes once a trip was boarded there, so the
+    // waits can be read off the final arrivals; rides are read off the
+    // schedule
+    Raptor::Journey journey{{}, target_arrival - departure_time};
+    for (uint32_t stop = to; stop != from; ) {
+        const auto [boarded, left] = ws.leg[stop];
+        const Connection& board = connections_[boarded];
+        const Connection& alight = connections_[left];
+        const Trip& trip = trips_[board.trip];
+        journey.legs.push_back({trip.route, board.from_stop, stop,
+                                static_cast<int>(alight.position + 1 - board.position),
+                                board.departure - ws.arrival[board.from_stop],
+                                minutes_[trip.minutes + alight.position + 1] - minutes_[trip.minutes + board.position]});
+        stop = board.from_stop;
+    }
+    reverse(begin(journey.legs), end(journey.legs));
+    return journey;
+}
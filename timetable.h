@@ -0,0 +1,81 @@
+#pragma once
+
+#include "raptor.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Earliest-arrival routing over real departures with the Connection Scan
+// Algorithm. Every trip is cut into connections between consecutive stops
+// and all of them sit in one contiguous array sorted by departure, so a
+// query is a single forward scan from the departure time that ends once no
+// connection can still improve the arrival at the target. Waiting is
+// whatever the timetable implies; there is no fixed boarding time.
+class Timetable {
+public:
+    // the trips of one route: its stops in travel order, the minutes from
+    // the departure at the first stop to each of them, and the departures
+    struct Schedule {
+        std::string_view route;
+        std::vector<uint32_t> stops;
+        std::vector<double> minutes;
+        std::vector<double> departures;
+    };
+
+    Timetable(size_t stop_count, const std::vector<Schedule>& schedules);
+
+    // the journey arriving first when leaving `from` at departure_time
+    // (minutes since midnight); legs wait for the trips they board
+    std::optional<Raptor::Journey> FindJourney(uint32_t from, uint32_t to, double departure_time) const;
+
+    size_t GetConnectionCount() const {
+        return connections_.size();
+    }
+
+    // connections looked at by the last query on the calling thread
+    static size_t LastScannedConnections() {
+        return last_scanned_;
+    }
+
+private:
+    struct Connection {
+        double departure;
+        double arrival;
+        uint32_t from_stop;
+        uint32_t to_stop;
+        uint32_t trip;
+        // index of from_stop within the trip
+        uint32_t position;
+    };
+
+    struct Trip {
+        std::string_view route;
+        // where the minutes of the trip's schedule start in minutes_
+        uint32_t minutes;
+    };
+
+    struct Workspace {
+        std::vector<double> arrival;
+        std::vector<uint32_t> reached;
+        // connections of the trip a stop was reached by: boarded and left
+        std::vector<std::pair<uint32_t, uint32_t>> leg;
+        // connection at which each trip was boarded
+        std::vector<uint32_t> boarded_at;
+        std::vector<uint32_t> boarded;
+        uint32_t generation = 0;
+    };
+    static Workspace& GetWorkspace() {
+        thread_local Workspace workspace;
+        return workspace;
+    }
+
+    const size_t stop_count_;
+    std::vector<Connection> connections_;
+    std::vector<Trip> trips_;
+    // minutes of every schedule one after another, so that ride times come
+    // from the schedule and not from sums of absolute times
+    std::vector<double> minutes_;
+    static thread_local size_t last_scanned_;
+};
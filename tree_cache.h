@@ -0,0 +1,125 @@
+#pragma once
+
+#include "graph.h"
+#include "path_search.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  struct TreeCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+  };
+
+  // Shortest path trees computed the first time their source is queried and
+  // kept, least recently used first out, within a memory budget; at least
+  // the last tree is always kept. A path read off a tree is the one
+  // PathSearch::FindPath finds, since a search stopped at the target has
+  // settled the same vertices with the same last edges. Trees are shared,
+  // so a caller may keep reading one after it is evicted. A miss runs the
+  // search outside the lock; two threads missing on the same source both
+  // compute it and the first one stored is kept.
+  template <typename Weight>
+  class TreeCache {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using Tree = ShortestPathTree<Weight>;
+
+  public:
+    TreeCache(const Graph& graph, size_t capacity_bytes)
+        : graph_(graph),
+          search_(graph),
+          tree_bytes_(graph.GetVertexCount() * (sizeof(Weight) + sizeof(EdgeId))),
+          capacity_(std::max<size_t>(1, capacity_bytes / std::max<size_t>(1, tree_bytes_))) {}
+
+    std::optional<Path<Weight>> FindPath(VertexId from, VertexId to) const;
+
+    std::shared_ptr<const Tree> GetTree(VertexId from) const;
+
+    // trees that fit the budget, and those held now
+    size_t GetCapacity() const {
+      return capacity_;
+    }
+    size_t GetSize() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return trees_.size();
+    }
+    size_t GetMemoryUsage() const {
+      return GetSize() * tree_bytes_;
+    }
+    TreeCacheStats GetStats() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return stats_;
+    }
+
+  private:
+    using Entry = std::pair<VertexId, std::shared_ptr<const Tree>>;
+
+    const Graph& graph_;
+    const PathSearch<Weight> search_;
+    const size_t tree_bytes_;
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    // most recently used first
+    mutable std::list<Entry> trees_;
+    mutable std::unordered_map<VertexId, typename std::list<Entry>::iterator> positions_;
+    mutable TreeCacheStats stats_;
+  };
+
+
+  template <typename Weight>
+  std::shared_ptr<const ShortestPathTree<Weight>> TreeCache<Weight>::GetTree(VertexId from) const {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (const auto it = positions_.find(from); it != positions_.end()) {
+        ++stats_.hits;
+        trees_.splice(trees_.begin(), trees_, it->second);
+        return it->second->second;
+      }
+      ++stats_.misses;
+    }
+
+    auto tree = std::make_shared<const Tree>(search_.BuildTree(from));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (const auto it = positions_.find(from); it != positions_.end()) {
+      return it->second->second;
+    }
+    while (trees_.size() >= capacity_) {
+      positions_.erase(trees_.back().first);
+      trees_.pop_back();
+      ++stats_.evictions;
+    }
+    trees_.emplace_front(from, tree);
+    positions_[from] = trees_.begin();
+    return tree;
+  }
+
+  template <typename Weight>
+  std::optional<Path<Weight>> TreeCache<Weight>::FindPath(VertexId from, VertexId to) const {
+    const auto tree = GetTree(from);
+    if (!tree->Reached(to)) {
+      return std::nullopt;
+    }
+    Path<Weight> path{tree->distance[to], {}};
+    for (VertexId vertex = to; vertex != from; ) {
+      const EdgeId edge_id = tree->prev_edge[vertex];
+      path.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(std::begin(path.edges), std::end(path.edges));
+    return path;
+  }
+
+}